@@ -18,6 +18,12 @@ namespace gr {
      * \brief <+description of block+>
      * \ingroup radar_dsp
      *
+     * With \p sc16_input the block takes std::complex<int16_t> samples
+     * (e.g. from usrp_tx_rx with sc16 output), where full scale (32767)
+     * corresponds to 1.0. The threshold is still given in that float scale.
+     * The threshold test runs on the integers, and only the captured
+     * samples are converted to gr_complex. \p energy_threshold is a
+     * magnitude and must not be negative.
      */
     class RADAR_DSP_API energy_trigger : virtual public gr::block
     {
@@ -32,7 +38,7 @@ namespace gr {
        * class. radar_dsp::energy_trigger::make is the public interface for
        * creating new instances.
        */
-      static sptr make(float energy_threshold, int buf_len_before, int buf_len_at_after);
+      static sptr make(float energy_threshold, int buf_len_before, int buf_len_at_after, bool sc16_input = false);
     };
 
   } // namespace radar_dsp
@@ -10,20 +10,50 @@
 
 #include <gnuradio/radar_dsp/api.h>
 #include <gnuradio/block.h>
+#include <vector>
 
 namespace gr {
   namespace radar_dsp {
 
     /*!
-     * \brief <+description of block+>
+     * \brief Estimates the frequency of the strongest tone in each fft_size vector
      * \ingroup radar_dsp
      *
+     * \details
+     * The peak bin of the spectrum is refined with a three-bin interpolator,
+     * producing one frequency (Hz) per input vector. By default the input is
+     * expected to already be an FFT. With \p time_domain set, the block takes
+     * raw samples instead and runs its own forward FFT, optionally windowed
+     * by \p window. The interpolator is exact for a rectangular window, so
+     * leave \p window empty unless leakage from other tones is the bigger
+     * error source.
+     *
+     * The CHIRP_Z estimator instead zooms into the two bins around the coarse
+     * peak with a chirp-z transform of \p zoom_points points, evaluated through
+     * a Bluestein kernel that is precomputed at construction. This gives
+     * sub-bin resolution without zero-padding the whole FFT.
+     *
+     * The ESPRIT estimator separates \p n_harmonics closely spaced tones per
+     * vector. It keeps a \p subspace_len x \p subspace_len sample covariance that
+     * is updated recursively with forgetting factor \p forgetting, so each
+     * vector only costs a small eigen-decomposition. In this mode output 0
+     * carries n_harmonics signed frequencies (ascending) per vector. ESPRIT
+     * works on the unwindowed samples, \p window is not applied.
+     *
+     * The optional second output carries the amplitude of each reported tone,
+     * in the same units as the time-domain samples.
      */
     class RADAR_DSP_API harmonic_retrieval : virtual public gr::block
     {
      public:
       typedef std::shared_ptr<harmonic_retrieval> sptr;
 
+      enum estimator_t {
+        INTERP_3BIN = 0,  // Closed-form interpolation from the peak bin and its neighbours
+        CHIRP_Z = 1,      // Chirp-z zoom over [k-1, k+1) bins around the peak bin k
+        ESPRIT = 2,       // Subspace estimate of several tones from a recursive covariance
+      };
+
       /*!
        * \brief Return a shared_ptr to a new instance of radar_dsp::harmonic_retrieval.
        *
@@ -31,8 +61,20 @@ namespace gr {
        * constructor is in a private implementation
        * class. radar_dsp::harmonic_retrieval::make is the public interface for
        * creating new instances.
+       *
+       * \param samp_rate Sample rate of the time-domain signal (Hz)
+       * \param fft_size Number of samples (or bins) in each input vector
+       * \param time_domain Input vectors are time samples rather than FFT bins
+       * \param window Window applied before the internal FFT (empty for rectangular, not used by ESPRIT)
+       * \param estimator Frequency refinement method applied around the peak bin
+       * \param zoom_points Number of chirp-z points spanning the two bins around the peak
+       * \param n_harmonics Number of tones estimated per vector (ESPRIT only)
+       * \param subspace_len Covariance size, must exceed n_harmonics (ESPRIT only)
+       * \param forgetting Weight of the previous covariance in [0, 1), 0 rebuilds it every vector (ESPRIT only)
        */
-      static sptr make(int samp_rate, int fft_size);
+      static sptr make(int samp_rate, int fft_size, bool time_domain = false, const std::vector<float>& window = std::vector<float>(),
+                       estimator_t estimator = INTERP_3BIN, int zoom_points = 64,
+                       int n_harmonics = 1, int subspace_len = 16, float forgetting = 0.9);
     };
 
   } // namespace radar_dsp
@@ -0,0 +1,57 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2023 Luke Jacobs.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef INCLUDED_RADAR_DSP_HEADER_DECODER_H
+#define INCLUDED_RADAR_DSP_HEADER_DECODER_H
+
+#include <gnuradio/radar_dsp/api.h>
+#include <gnuradio/sync_block.h>
+
+namespace gr {
+  namespace radar_dsp {
+
+    /*!
+     * \brief Decodes the count_till_switch header of received ranging packets.
+     * \ingroup radar_dsp
+     *
+     * The inputs are selfref_framesync's packet output (the symbols that
+     * follow the training sequence), the matching CFO estimate and
+     * channel_estimator's output. Each packet is derotated by the CFO
+     * (counted from the start of the training sequence, as in
+     * channel_estimator) and by the channel estimate. Then the first 32
+     * symbols are sliced into the on-off keyed count_till_switch field that
+     * usrp_tx_rx sends, least significant bit first. The decision threshold
+     * is half the strongest bit, which works because a sent count is never
+     * zero.
+     *
+     * Every decoded header is published on the "header" message port as a
+     * dictionary with "count_till_switch" (long) and "margin" (double). The
+     * margin is the distance of the weakest bit from the threshold,
+     * relative to the threshold; near zero means a doubtful decision. The
+     * optional output carries the equalized packet, tagged with the same
+     * "count_till_switch".
+     */
+    class RADAR_DSP_API header_decoder : virtual public gr::sync_block
+    {
+     public:
+      typedef std::shared_ptr<header_decoder> sptr;
+
+      /*!
+       * \brief Return a shared_ptr to a new instance of radar_dsp::header_decoder.
+       *
+       * To avoid accidental use of raw pointers, radar_dsp::header_decoder's
+       * constructor is in a private implementation
+       * class. radar_dsp::header_decoder::make is the public interface for
+       * creating new instances.
+       */
+      static sptr make(int training_seq_len, int packet_len, float samp_rate);
+    };
+
+  } // namespace radar_dsp
+} // namespace gr
+
+#endif /* INCLUDED_RADAR_DSP_HEADER_DECODER_H */
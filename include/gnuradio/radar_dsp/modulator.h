@@ -0,0 +1,52 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2023 Luke Jacobs.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef INCLUDED_RADAR_DSP_MODULATOR_H
+#define INCLUDED_RADAR_DSP_MODULATOR_H
+
+#include <gnuradio/radar_dsp/api.h>
+#include <gnuradio/sync_interpolator.h>
+
+namespace gr {
+  namespace radar_dsp {
+
+    /*!
+     * \brief Modulates a byte stream into root-raised-cosine shaped BPSK or QPSK.
+     * \ingroup radar_dsp
+     *
+     * \p bits_per_symbol selects BPSK (1) or QPSK (2, Gray coded). Bits are
+     * sent least significant first. In QPSK the even bit of each pair goes
+     * on I and the odd bit on Q. Each byte becomes 8 / \p bits_per_symbol
+     * symbols of \p samps_per_sym samples. The pulse has a roll-off of
+     * \p excess_bw and spans 11 symbols.
+     *
+     * Symbols are mapped with a byte lookup table and shaped with a
+     * polyphase interpolator, so no multiplications are spent on the zeros
+     * of an upsampled signal. This is the same modulator that usrp_tx_rx
+     * uses for its packets, which makes the block suitable for generating
+     * test waveforms in bulk. The output is continuous across calls.
+     */
+    class RADAR_DSP_API modulator : virtual public gr::sync_interpolator
+    {
+     public:
+      typedef std::shared_ptr<modulator> sptr;
+
+      /*!
+       * \brief Return a shared_ptr to a new instance of radar_dsp::modulator.
+       *
+       * To avoid accidental use of raw pointers, radar_dsp::modulator's
+       * constructor is in a private implementation
+       * class. radar_dsp::modulator::make is the public interface for
+       * creating new instances.
+       */
+      static sptr make(int bits_per_symbol, int samps_per_sym, float excess_bw = 0.35);
+    };
+
+  } // namespace radar_dsp
+} // namespace gr
+
+#endif /* INCLUDED_RADAR_DSP_MODULATOR_H */
@@ -15,15 +15,46 @@ namespace gr {
 namespace radar_dsp {
 
 /*!
- * \brief <+description of block+>
+ * \brief Matched-filters input_buffer_len sample vectors and decimates them at the best symbol phase
  * \ingroup radar_dsp
  *
+ * \details
+ * Each vector is convolved with a root-raised-cosine matched filter of
+ * roll-off \p excess_bw and the decimation phase with the highest average
+ * symbol magnitude is written out at one sample per symbol.
+ *
+ * By default every vector is handled on its own ("full" convolution, so each
+ * vector carries filter transients at both edges). With \p streaming set,
+ * consecutive vectors are treated as one continuous capture. The filter and
+ * symbol phase carry over between vectors, the output is a steady symbol
+ * stream, and the best phase is only searched again every
+ * \p reeval_interval vectors or when the current phase loses energy.
+ *
+ * Instead of the energy search, \p timing can select a closed-loop Gardner or
+ * Mueller-Muller timing recovery with loop bandwidth \p loop_bw (normalized
+ * to the symbol rate). It interpolates the symbol strobe with a 32-arm
+ * polyphase matched filterbank and follows sampling-clock drift continuously.
+ * It always treats the input as one stream and expects roughly unit-amplitude
+ * symbols (put an AGC in front).
+ *
+ * About once a second the block publishes a statistics dictionary on the
+ * "stats" message port. It holds the number of work calls, the vectors
+ * processed, a histogram of the chosen shifts, and the average energy margin
+ * between the best and second-best shift. The same figures are readable
+ * through ControlPort. With \p verbose set, a one-line summary is also
+ * printed at the same rate.
  */
 class RADAR_DSP_API pulse_align : virtual public gr::block
 {
 public:
     typedef std::shared_ptr<pulse_align> sptr;
 
+    enum timing_t {
+        ENERGY_SEARCH = 0,   // Pick the decimation phase with the most energy
+        GARDNER = 1,         // Gardner timing error detector (decision-free)
+        MUELLER_MULLER = 2,  // Mueller-Muller timing error detector (decision-directed)
+    };
+
     /*!
      * \brief Return a shared_ptr to a new instance of radar_dsp::pulse_align.
      *
@@ -31,8 +62,35 @@ public:
      * constructor is in a private implementation
      * class. radar_dsp::pulse_align::make is the public interface for
      * creating new instances.
+     *
+     * \param input_buffer_len Number of samples in each input vector
+     * \param samp_rate Sample rate (Hz)
+     * \param samps_per_sym Samples per symbol
+     * \param streaming Treat consecutive vectors as one continuous stream
+     * \param reeval_interval Vectors between phase searches in streaming mode
+     * \param timing Symbol timing method
+     * \param loop_bw Timing loop bandwidth relative to the symbol rate (GARDNER/MUELLER_MULLER only)
+     * \param verbose Print a rate-limited statistics summary to stdout
+     * \param excess_bw Roll-off of the RRC matched filter, must match the transmitter's
      */
-    static sptr make(int input_buffer_len, float samp_rate, int samps_per_sym);
+    static sptr make(int input_buffer_len,
+                     float samp_rate,
+                     int samps_per_sym,
+                     bool streaming = false,
+                     int reeval_interval = 16,
+                     timing_t timing = ENERGY_SEARCH,
+                     float loop_bw = 0.01,
+                     bool verbose = false,
+                     float excess_bw = 0.35);
+
+    //! Number of general_work calls so far
+    virtual long calls() const = 0;
+
+    //! Number of input vectors processed so far
+    virtual long vectors_processed() const = 0;
+
+    //! Average ratio between the best and second-best shift energies of the energy search
+    virtual double energy_margin() const = 0;
 };
 
 } // namespace radar_dsp
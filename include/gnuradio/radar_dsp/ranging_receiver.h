@@ -0,0 +1,57 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2023 Luke Jacobs.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef INCLUDED_RADAR_DSP_RANGING_RECEIVER_H
+#define INCLUDED_RADAR_DSP_RANGING_RECEIVER_H
+
+#include <gnuradio/radar_dsp/api.h>
+#include <gnuradio/sync_block.h>
+
+namespace gr {
+  namespace radar_dsp {
+
+    /*!
+     * \brief Turns a detected packet into a distance estimate in one pass.
+     * \ingroup radar_dsp
+     *
+     * Fuses cfo_estimator, channel_estimator, phase_measurement and lls,
+     * using the same kernels. The inputs are selfref_framesync's packet
+     * output and its received training sequence output. Each packet
+     * yields:
+     * - the CFO from the training sequence,
+     * - the tone phases measured over the packet at
+     *   \p tone_frequencies shifted by that CFO,
+     * - the distance from the line fit of those phases around carrier
+     *   \p f_c.
+     * There are no intermediate buffers between the stages.
+     *
+     * Output 0 is the distance in metres. The optional outputs 1-3 carry
+     * the intermediate results, in the formats the separate blocks
+     * produce: the CFO (float), the channel estimate against \p ts_buf
+     * (complex), and the tone phases (float vector of
+     * tone_frequencies.size()).
+     */
+    class RADAR_DSP_API ranging_receiver : virtual public gr::sync_block
+    {
+     public:
+      typedef std::shared_ptr<ranging_receiver> sptr;
+
+      /*!
+       * \brief Return a shared_ptr to a new instance of radar_dsp::ranging_receiver.
+       *
+       * To avoid accidental use of raw pointers, radar_dsp::ranging_receiver's
+       * constructor is in a private implementation
+       * class. radar_dsp::ranging_receiver::make is the public interface for
+       * creating new instances.
+       */
+      static sptr make(int training_seq_len, int packet_len, float samp_rate, const std::vector<gr_complex>& ts_buf, float f_c, const std::vector<float>& tone_frequencies);
+    };
+
+  } // namespace radar_dsp
+} // namespace gr
+
+#endif /* INCLUDED_RADAR_DSP_RANGING_RECEIVER_H */
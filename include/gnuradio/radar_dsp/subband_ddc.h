@@ -0,0 +1,54 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2023 Luke Jacobs.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef INCLUDED_RADAR_DSP_SUBBAND_DDC_H
+#define INCLUDED_RADAR_DSP_SUBBAND_DDC_H
+
+#include <gnuradio/radar_dsp/api.h>
+#include <gnuradio/sync_decimator.h>
+
+namespace gr {
+  namespace radar_dsp {
+
+    /*!
+     * \brief Splits one wideband capture into several decimated sub-bands.
+     * \ingroup radar_dsp
+     *
+     * Output i carries the band centred \p offsets[i] Hz away from the
+     * capture's centre, moved to DC and decimated by \p decimation. All
+     * bands share one low-pass prototype that passes \p bandwidth Hz and
+     * only lets aliases land outside that passband. The prototype is
+     * rotated to each band, so each band costs one decimating FIR
+     * (computed only at the output rate) and one rotation per output
+     * sample.
+     *
+     * Every band is mixed down by an NCO that starts at the first input
+     * sample, so output phases are continuous across calls. Tones received
+     * at the same instant in different bands keep their relative phase. Tags
+     * such as usrp_tx_rx's "rx_freq" pass through to every output, so the
+     * absolute frequency of band i is rx_freq + offsets[i].
+     */
+    class RADAR_DSP_API subband_ddc : virtual public gr::sync_decimator
+    {
+     public:
+      typedef std::shared_ptr<subband_ddc> sptr;
+
+      /*!
+       * \brief Return a shared_ptr to a new instance of radar_dsp::subband_ddc.
+       *
+       * To avoid accidental use of raw pointers, radar_dsp::subband_ddc's
+       * constructor is in a private implementation
+       * class. radar_dsp::subband_ddc::make is the public interface for
+       * creating new instances.
+       */
+      static sptr make(float sampling_rate, const std::vector<double>& offsets, int decimation, float bandwidth);
+    };
+
+  } // namespace radar_dsp
+} // namespace gr
+
+#endif /* INCLUDED_RADAR_DSP_SUBBAND_DDC_H */
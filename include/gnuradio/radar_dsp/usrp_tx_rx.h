@@ -15,9 +15,82 @@ namespace gr {
   namespace radar_dsp {
 
     /*!
-     * \brief <+description of block+>
+     * \brief Alternates between transmitting ranging packets and streaming received samples.
      * \ingroup radar_dsp
      *
+     * \p args are device args. They are passed to UHD unless they contain
+     * "type=loopback", which runs the block against an in-process simulated
+     * radio instead. Loopback instances with the same "group" hear each other
+     * through a channel model set by the keys delay (s), cfo (Hz),
+     * phase_noise (rad per sample), noise (RMS amplitude), clock_ppm and seed,
+     * e.g. "type=loopback,group=bench,delay=1e-6,cfo=200,noise=0.01".
+     *
+     * With \p rx_thread set, a dedicated thread (pinned to CPU \p rx_core
+     * unless it is negative) drains the radio into a lock-free ring holding
+     * a quarter second of samples, and the work function only copies out of
+     * that ring. Scheduler stalls downstream then no longer overflow the
+     * device.
+     *
+     * Everything is scheduled on device time. Time is divided into rounds
+     * of \p round_seconds starting at multiples of that length. A node
+     * created with \p start_tx transmits in even rounds and receives in odd
+     * rounds, and its peer does the opposite. Each new exchange (pair of
+     * rounds) moves both nodes 100 MHz up with a timed tune, unless a hop
+     * plan is set (see set_hop_plan()). TX rounds queue their packets as
+     * timed bursts. RX rounds are timed receive windows that last until the
+     * next round begins. The output is tagged "rx_freq" (value: carrier in
+     * Hz) wherever a new carrier has settled.
+     *
+     * With \p full_duplex set, RX streams continuously from the first
+     * round on, and a TX worker thread schedules the bursts. Both nodes then
+     * transmit in every round: the \p start_tx node in the first half, its
+     * peer in the second half. Every round is a full exchange and hops the
+     * carrier. Each of the node's own bursts is tagged "tx_burst" (value:
+     * the packet's count field) on the output sample where it starts. The
+     * tag marks where the node's own TX leakage appears, which serves as a
+     * timing reference.
+     *
+     * By default the block receives on \p channel. \p rx_channels selects
+     * several RX channels instead (e.g. {0, 1} for both front ends). They
+     * are streamed through one multi-channel streamer into one output each,
+     * so the outputs are sample-aligned and tuned together. TX always uses
+     * \p channel.
+     *
+     * With \p sc16_output the outputs carry std::complex<int16_t> samples
+     * as they come off the wire (full scale 32767), instead of converting
+     * every sample to gr_complex. Connect them to a detector that takes sc16
+     * (e.g. energy_trigger with sc16_input), so only detected packets are
+     * converted to float.
+     *
+     * With \p rx_burst_guard > 0 (half duplex only), RX rounds no longer
+     * receive the whole round. Each packet the peer is scheduled to send
+     * gets its own timed NUM_SAMPS_AND_DONE window, from \p rx_burst_guard
+     * seconds before the packet to as long after its end. The guard must
+     * cover the propagation delay and any clock offset between the nodes.
+     * In every mode, the first sample of each received burst (and any
+     * sample after a gap) is tagged "rx_time" with the device time, in
+     * gr-uhd's format: a tuple of integer seconds (uint64) and fractional
+     * seconds (double).
+     *
+     * Packets are shaped with a root-raised-cosine pulse of roll-off
+     * \p excess_bw; the receive chain's matched filter must use the same.
+     *
+     * About once a second the block publishes a statistics dictionary on the
+     * "stats" message port. It holds counters for RX overflows, TX
+     * underflows, late RX windows and late TX bursts. It also holds counters
+     * for receive timeouts after a window should have started, samples
+     * delivered, TX packets sent and samples dropped by the RX thread. It
+     * includes "latency_hist", a histogram of the time from recv to produce.
+     * Bin k counts latencies in [2^k, 2^(k+1)) us, and the last bin also
+     * counts anything longer. The counters are also readable through
+     * ControlPort.
+     *
+     * At start the device time is reset to zero at the next PPS edge,
+     * unless it is already running on the PPS (the last PPS fell on a
+     * whole second within the last PPS period). A time set by an earlier
+     * run is therefore kept across flowgraph and process restarts.
+     * Startup waits for the PPS edge and for the LOs' "lo_locked" sensors
+     * rather than sleeping for fixed times.
      */
     class RADAR_DSP_API usrp_tx_rx : virtual public gr::block
     {
@@ -32,7 +105,46 @@ namespace gr {
        * class. radar_dsp::usrp_tx_rx::make is the public interface for
        * creating new instances.
        */
-      static sptr make(int channel, float carrier_freq, float sampling_rate, int samps_per_sym, float gain, int packet_len, bool start_tx, const std::vector<gr_complex>& ts_buf);
+      static sptr make(int channel, float carrier_freq, float sampling_rate, int samps_per_sym, float gain, int packet_len, bool start_tx, const std::vector<gr_complex>& ts_buf, const std::string& args = "", bool rx_thread = false, int rx_core = -1, float round_seconds = 5.0, bool full_duplex = false, const std::vector<int>& rx_channels = std::vector<int>(), bool sc16_output = false, float rx_burst_guard = 0.0, float excess_bw = 0.35);
+
+      //! RX overflows reported by the device
+      virtual long overflows() const = 0;
+
+      //! TX underflows reported by the device
+      virtual long underflows() const = 0;
+
+      //! RX windows that started late
+      virtual long late_commands() const = 0;
+
+      //! TX bursts that reached the device too late
+      virtual long late_bursts() const = 0;
+
+      //! recv timeouts after an RX window should have started
+      virtual long timeouts() const = 0;
+
+      //! Samples produced on each output
+      virtual long samples_delivered() const = 0;
+
+      //! Ranging packets sent
+      virtual long tx_packets() const = 0;
+
+      //! Samples dropped by the RX thread while its ring was full
+      virtual long rx_dropped() const = 0;
+
+      /*!
+       * \brief Sets the carriers visited in every round.
+       *
+       * Each round starts at \p freqs[0] and moves on to the next carrier
+       * after the matching entry of \p dwell_seconds, wrapping around until
+       * no further dwell fits into the round. Each dwell carries one packet
+       * (one per node in full duplex), and its tune is queued as a timed
+       * command with the rest of the round. Carriers within \p dsp_range Hz
+       * of the current LO are reached by retuning the DSP only, so the LO
+       * does not relock; set it to what the front end's bandwidth allows
+       * around the LO. Empty lists restore the fixed 100 MHz step per
+       * exchange. Takes effect from the next round that is scheduled.
+       */
+      virtual void set_hop_plan(const std::vector<double>& freqs, const std::vector<double>& dwell_seconds, double dsp_range = 0.0) = 0;
     };
 
   } // namespace radar_dsp
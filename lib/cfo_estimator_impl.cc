@@ -6,8 +6,8 @@
  */
 
 #include "cfo_estimator_impl.h"
+#include "ranging_kernels.h"
 #include <gnuradio/io_signature.h>
-#include <armadillo>
 
 namespace gr {
 namespace radar_dsp {
@@ -15,8 +15,6 @@ namespace radar_dsp {
 using input_type = gr_complex;
 using output_type = float;
 
-static const double PI = 3.14159265358979323;  // std::acos(-1);
-
 cfo_estimator::sptr cfo_estimator::make(int training_seq_len, float samp_rate)
 {
    return gnuradio::make_block_sptr<cfo_estimator_impl>(training_seq_len, samp_rate);
@@ -50,12 +48,7 @@ int cfo_estimator_impl::work(int noutput_items,
     /* Estimate the frequency offset that needs to be added to TX's carrier to get RX's carrier.
        This block can be used to "unspin" the components of a vector. */
     for (int vec_i = 0; vec_i < noutput_items; vec_i++) {
-        const gr_complex *vec_start = in+vec_i*d_training_seq_len;
-        arma::cx_fvec first_half(std::vector<gr_complex>(vec_start, vec_start+d_training_seq_len/2)),
-                      second_half(std::vector<gr_complex>(vec_start+d_training_seq_len/2, vec_start+d_training_seq_len));
-        float cfo_est = std::arg(arma::sum(first_half.t() * second_half)) * d_samp_rate / (2*PI*d_training_seq_len/2);
-        out[vec_i] = -cfo_est;
-        // std::cout << cfo_est << "\n";
+        out[vec_i] = estimate_cfo(in + vec_i * d_training_seq_len, d_training_seq_len, d_samp_rate);
     }
 
     // Tell runtime system how many output items we produced.
@@ -7,12 +7,12 @@
 
 #include <gnuradio/io_signature.h>
 #include "channel_estimator_impl.h"
+#include "ranging_kernels.h"
+#include <iostream>
 
 namespace gr {
   namespace radar_dsp {
 
-  static const double PI = 3.14159265358979323;  // std::acos(-1);
-
     channel_estimator::sptr channel_estimator::make(const std::string block_name, int training_seq_len, float samp_rate, const std::vector<gr_complex>& ts_buf)
     {
       return gnuradio::make_block_sptr<channel_estimator_impl>(block_name, training_seq_len, samp_rate, ts_buf);
@@ -28,9 +28,9 @@ namespace gr {
                        gr::io_signature::make(1 /* min outputs */, 1 /*max outputs */, sizeof(gr_complex))),
         d_training_seq_len(training_seq_len),
         d_samp_rate(samp_rate),
+        d_ts_buf(ts_buf),
         d_block_name(block_name)
     {
-      d_ts_buf = arma::cx_fvec(ts_buf);
     }
 
     /*
@@ -45,19 +45,8 @@ namespace gr {
       auto out = static_cast<gr_complex *>(output_items[0]);
       
       for (int vec_i = 0; vec_i < noutput_items; vec_i++) {
-        // Undo CFO with the given CFO estimate
-        std::vector<gr_complex> rx_ts_buf(rx_ts_in+vec_i*d_training_seq_len, rx_ts_in+(vec_i+1)*d_training_seq_len);
-        arma::cx_fvec rx_ts_vec_before_cfo(rx_ts_buf);
-        // rx_ts_vec_before_cfo.print("RX TS Before CFO Correction:\n");
-        for (int i = 0; i < d_training_seq_len; i++) {
-          rx_ts_buf[i] *= std::exp(std::complex(0.0, 2.0*PI*cfo_est_in[vec_i]*i/d_samp_rate));  // The CFO estimate needs to have the correct sign or else this will not work
-        }
-
-        // Correlate the received training sequence against the transmitted copy
-        arma::cx_fvec rx_ts_vec(rx_ts_buf);
-        // rx_ts_vec.print("RX TS After CFO Correction:\n");
-        gr_complex corr = arma::sum(rx_ts_vec.t() * d_ts_buf);  // TODO Check the order of the dot product
-        gr_complex unit_rotation = corr / std::abs(corr);
+        // Undo the CFO, then correlate the received training sequence against the transmitted copy
+        gr_complex unit_rotation = estimate_channel(rx_ts_in + vec_i * d_training_seq_len, d_ts_buf.data(), d_training_seq_len, cfo_est_in[vec_i], d_samp_rate);
         out[vec_i] = unit_rotation;
 
         std::cout << "[" << d_block_name << "] Channel Estimation: " << std::arg(unit_rotation) << std::endl << std::flush;
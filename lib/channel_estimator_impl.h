@@ -9,7 +9,6 @@
 #define INCLUDED_RADAR_DSP_CHANNEL_ESTIMATOR_IMPL_H
 
 #include <gnuradio/radar_dsp/channel_estimator.h>
-#include <armadillo>
 
 namespace gr {
   namespace radar_dsp {
@@ -19,7 +18,7 @@ namespace gr {
      private:
       int d_training_seq_len;
       float d_samp_rate;
-      arma::cx_fvec d_ts_buf;
+      std::vector<gr_complex> d_ts_buf;
       const std::string d_block_name;
 
      public:
@@ -7,14 +7,28 @@
 
 #include "energy_trigger_impl.h"
 #include <gnuradio/io_signature.h>
+#include <volk/volk.h>
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
 
 namespace gr {
 namespace radar_dsp {
 
 energy_trigger::sptr
-energy_trigger::make(float energy_threshold, int buf_len_before, int buf_len_at_after)
+energy_trigger::make(float energy_threshold, int buf_len_before, int buf_len_at_after, bool sc16_input)
 {
-    return gnuradio::make_block_sptr<energy_trigger_impl>(energy_threshold, buf_len_before, buf_len_at_after);
+    return gnuradio::make_block_sptr<energy_trigger_impl>(energy_threshold, buf_len_before, buf_len_at_after, sc16_input);
+}
+
+// sc16 value that corresponds to 1.0
+static const float SC16_FULL_SCALE = 32767.0;
+
+// Squared threshold in sc16 units, computed in double and saturated to the 32-bit range
+static uint32_t sc16_threshold_sq(float energy_threshold)
+{
+  double scaled = (double)energy_threshold * SC16_FULL_SCALE;
+  return (uint32_t)std::min(std::floor(scaled * scaled), 4294967295.0);
 }
 
 /*
@@ -22,15 +36,23 @@ energy_trigger::make(float energy_threshold, int buf_len_before, int buf_len_at_
  */
 energy_trigger_impl::energy_trigger_impl(float energy_threshold,
                                          int buf_len_before,
-                                         int buf_len_at_after)
+                                         int buf_len_at_after,
+                                         bool sc16_input)
     : gr::block("energy_trigger",
-                gr::io_signature::make(1 /* min inputs */, 1 /* max inputs */, sizeof(gr_complex)),
+                gr::io_signature::make(1 /* min inputs */, 1 /* max inputs */, sc16_input ? sizeof(std::complex<int16_t>) : sizeof(gr_complex)),
                 gr::io_signature::make(1 /* min outputs */, 1 /*max outputs */, (buf_len_before+buf_len_at_after)*sizeof(gr_complex))),
       d_buf_len_before(buf_len_before),
       d_buf_len_at_after(buf_len_at_after),
       d_energy_threshold(energy_threshold),
+      d_sc16_input(sc16_input),
+      d_threshold_sq(energy_threshold * energy_threshold),
+      d_threshold_sq_sc16(sc16_threshold_sq(energy_threshold)),
       d_collecting(false)
 {
+  // The test compares squared magnitudes, so a negative threshold would silently act as its absolute value
+  if (energy_threshold < 0)
+    throw std::invalid_argument("energy_trigger: energy_threshold must not be negative");
+
   set_history(d_buf_len_before + 1);  // Stores buf_len_before number of samples plus at least one new one
   d_buf.clear();
 }
@@ -40,6 +62,28 @@ energy_trigger_impl::energy_trigger_impl(float energy_threshold,
  */
 energy_trigger_impl::~energy_trigger_impl() {}
 
+// Compares squared magnitudes, in integers for sc16 (|re|,|im| <= 32768, so the sum fits into 32 unsigned bits)
+bool energy_trigger_impl::above_threshold(const void* in, int samp_i) const
+{
+  if (d_sc16_input) {
+    const std::complex<int16_t> s = static_cast<const std::complex<int16_t> *>(in)[samp_i];
+    return (uint32_t)((int32_t)s.real() * s.real()) + (uint32_t)((int32_t)s.imag() * s.imag()) > d_threshold_sq_sc16;
+  }
+  return std::norm(static_cast<const gr_complex *>(in)[samp_i]) > d_threshold_sq;
+}
+
+void energy_trigger_impl::append(const void* in, int first, int n)
+{
+  if (d_sc16_input) {
+    size_t old_size = d_buf.size();
+    d_buf.resize(old_size + n);
+    volk_16i_s32f_convert_32f((float*)&d_buf[old_size], (const int16_t*)(static_cast<const std::complex<int16_t> *>(in) + first), SC16_FULL_SCALE, 2 * n);
+  } else {
+    const gr_complex* samples = static_cast<const gr_complex *>(in);
+    d_buf.insert(d_buf.end(), samples + first, samples + first + n);
+  }
+}
+
 void energy_trigger_impl::forecast(int noutput_items,
                                    gr_vector_int& ninput_items_required)
 {
@@ -51,19 +95,19 @@ int energy_trigger_impl::general_work(int noutput_items,
                                       gr_vector_const_void_star& input_items,
                                       gr_vector_void_star& output_items)
 {
-  auto in = static_cast<const gr_complex *>(input_items[0]);
+  const void* in = input_items[0];
   auto out = static_cast<gr_complex *>(output_items[0]);
 
   int n_new_items = ninput_items[0] - d_buf_len_before;
   for (int samp_i = 0; samp_i < n_new_items; samp_i++) {
-    if (!d_collecting && (std::abs(in[samp_i+d_buf_len_before]) > d_energy_threshold)) {
-      d_buf.insert(d_buf.end(), in+samp_i, in+samp_i+d_buf_len_before);  // Copy d_buf_len_before number of samples into the buffer
+    if (!d_collecting && above_threshold(in, samp_i+d_buf_len_before)) {
+      append(in, samp_i, d_buf_len_before);  // Copy d_buf_len_before number of samples into the buffer
       d_collecting = true;
       d_samps_to_write = d_buf_len_at_after;
     }
     // If in writing mode, write this sample to output buffer
     if (d_collecting && (d_samps_to_write > 0)) {
-      d_buf.push_back(in[samp_i+d_buf_len_before]);
+      append(in, samp_i+d_buf_len_before, 1);
       d_samps_to_write--;
     }
     // If finished writing
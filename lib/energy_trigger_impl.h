@@ -18,12 +18,17 @@ namespace gr {
      private:
       int d_buf_len_before, d_buf_len_at_after;
       float d_energy_threshold;
+      bool d_sc16_input;
+      float d_threshold_sq;           // Squared threshold in the float scale
+      uint32_t d_threshold_sq_sc16;   // Squared threshold in sc16 units
+      bool above_threshold(const void* in, int samp_i) const;
+      void append(const void* in, int first, int n);  // Appends n input samples to d_buf as gr_complex
       int d_samps_to_write;
       std::vector<gr_complex> d_buf;
       bool d_collecting;
 
      public:
-      energy_trigger_impl(float energy_threshold, int buf_len_before, int buf_len_at_after);
+      energy_trigger_impl(float energy_threshold, int buf_len_before, int buf_len_at_after, bool sc16_input);
       ~energy_trigger_impl();
 
       // Where all the action really happens
@@ -6,9 +6,12 @@
  */
 
 #include <gnuradio/io_signature.h>
+#include <volk/volk.h>
 #include <vector>
 #include <complex>
-#include <iterator>
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
 #include "harmonic_retrieval_impl.h"
 
 const float PI = 3.14159265358979323; // std::acos(-1);
@@ -21,22 +24,126 @@ namespace gr {
     using output_type = float;
 
     harmonic_retrieval::sptr
-    harmonic_retrieval::make(int samp_rate, int fft_size)
+    harmonic_retrieval::make(int samp_rate, int fft_size, bool time_domain, const std::vector<float>& window,
+                             estimator_t estimator, int zoom_points,
+                             int n_harmonics, int subspace_len, float forgetting)
     {
-      return gnuradio::make_block_sptr<harmonic_retrieval_impl>(samp_rate, fft_size);
+      return gnuradio::make_block_sptr<harmonic_retrieval_impl>(samp_rate, fft_size, time_domain, window, estimator, zoom_points,
+                                                                 n_harmonics, subspace_len, forgetting);
     }
 
 
     /*
      * The private constructor
      */
-    harmonic_retrieval_impl::harmonic_retrieval_impl(int samp_rate, int fft_size)
+    harmonic_retrieval_impl::harmonic_retrieval_impl(int samp_rate, int fft_size, bool time_domain, const std::vector<float>& window,
+                                                     estimator_t estimator, int zoom_points,
+                                                     int n_harmonics, int subspace_len, float forgetting)
       : gr::block("harmonic_retrieval",
                   gr::io_signature::make(1 /* min inputs */, 1 /* max inputs */, sizeof(input_type) * fft_size),
-                  gr::io_signature::make(1 /* min outputs */, 1 /*max outputs */, sizeof(output_type))),
+                  // Frequencies and (optionally) amplitudes, one per estimated tone
+                  gr::io_signature::make(1 /* min outputs */, 2 /*max outputs */,
+                                         sizeof(output_type) * (estimator == ESPRIT ? n_harmonics : 1))),
         d_samp_rate(samp_rate),
-        d_fft_size(fft_size)
-    {}
+        d_fft_size(fft_size),
+        d_time_domain(time_domain),
+        d_window(window),
+        d_estimator(estimator),
+        d_r_k_1(std::exp(-I * (float)2.0 * PI / (float)fft_size)),
+        d_cos_beta(fft_size),
+        d_zoom_points(zoom_points),
+        d_czt_len(0),
+        d_n_harmonics(estimator == ESPRIT ? n_harmonics : 1),
+        d_subspace_len(subspace_len),
+        d_forgetting(forgetting),
+        d_cov_valid(false)
+    {
+      // beta(k-1) and beta(k+1) wrap around with the spectrum, so a table over [0, N) covers every lookup
+      for (int k = 0; k < d_fft_size; k++) {
+        d_cos_beta[k] = std::cos(beta(k));
+      }
+
+      if (!d_window.empty() && (int)d_window.size() != d_fft_size) {
+        throw std::invalid_argument("harmonic_retrieval: window length must equal fft_size");
+      }
+      // Plan the FFT here so that general_work only ever executes it
+      if (d_time_domain) {
+        d_fft = std::make_unique<gr::fft::fft_complex_fwd>(d_fft_size);
+      }
+
+      // The chirp-z and ESPRIT estimators work on time samples, so FFT'd input has to be inverted first
+      if (d_estimator != INTERP_3BIN && !d_time_domain) {
+        d_ifft = std::make_unique<gr::fft::fft_complex_rev>(d_fft_size);
+      }
+
+      if (d_estimator == CHIRP_Z) {
+        if (d_zoom_points < 2) {
+          throw std::invalid_argument("harmonic_retrieval: zoom_points must be at least 2");
+        }
+
+        // Bluestein: X[m] = w[m] * sum_n (x[n] w[n]) h[m-n], with w[n] = exp(-j*delta*n^2/2) and
+        // h[l] = exp(+j*delta*l^2/2) for l in [-(N-1), M-1]. The linear convolution needs N+M-1 points.
+        int N = d_fft_size, M = d_zoom_points;
+        d_czt_len = 1;
+        while (d_czt_len < N + M - 1) d_czt_len <<= 1;
+        d_czt_fwd = std::make_unique<gr::fft::fft_complex_fwd>(d_czt_len);
+        d_czt_rev = std::make_unique<gr::fft::fft_complex_rev>(d_czt_len);
+
+        // The zoom spans 2 bins with M points, so delta = 2*pi*(2/M)/N and delta*n^2/2 = 2*pi*n^2/(M*N).
+        // Reducing n^2 modulo M*N in integers keeps the chirp phase exact for long vectors.
+        const long long period = (long long)M * N;
+        auto chirp = [period](long long l) {
+          return std::exp(I * (float)(2.0 * PI * (double)((l * l) % period) / (double)period));
+        };
+
+        d_czt_chirp.resize(N);
+        for (int n = 0; n < N; n++) {
+          d_czt_chirp[n] = std::conj(chirp(n));
+        }
+
+        gr_complex *kernel = d_czt_fwd->get_inbuf();
+        std::fill(kernel, kernel + d_czt_len, gr_complex(0.0, 0.0));
+        for (int l = 0; l < M; l++) {
+          kernel[l] = chirp(l);
+        }
+        for (int l = 1; l < N; l++) {
+          kernel[d_czt_len - l] = chirp(l);
+        }
+        d_czt_fwd->execute();
+        d_czt_kernel.assign(d_czt_fwd->get_outbuf(), d_czt_fwd->get_outbuf() + d_czt_len);
+        for (auto &h : d_czt_kernel) {
+          h /= (float)d_czt_len;  // Fold the inverse FFT normalization into the kernel
+        }
+
+        d_twiddle.resize(N);
+        for (int i = 0; i < N; i++) {
+          d_twiddle[i] = std::exp(-I * (float)(2.0 * PI * i / N));
+        }
+      }
+
+      if (d_estimator == ESPRIT) {
+        if (d_n_harmonics < 1 || d_subspace_len <= d_n_harmonics || d_subspace_len > d_fft_size) {
+          throw std::invalid_argument("harmonic_retrieval: ESPRIT needs 1 <= n_harmonics < subspace_len <= fft_size");
+        }
+        // 1 would keep the covariance of the first vector forever
+        if (d_forgetting < 0.0 || d_forgetting >= 1.0) {
+          throw std::invalid_argument("harmonic_retrieval: forgetting must lie in [0, 1)");
+        }
+        d_cov.zeros(d_subspace_len, d_subspace_len);
+        d_vec_cov.set_size(d_subspace_len, d_subspace_len);
+        d_eigval.set_size(d_subspace_len);
+        d_eigvec.set_size(d_subspace_len, d_subspace_len);
+        d_signal.set_size(d_subspace_len, d_n_harmonics);
+        d_phi.set_size(d_n_harmonics, d_n_harmonics);
+        d_poles.set_size(d_n_harmonics);
+        d_omega.resize(d_n_harmonics);
+        d_gains.set_size(d_n_harmonics);
+        d_snapshots.set_size(d_subspace_len, d_fft_size - d_subspace_len + 1);
+        d_vander.set_size(d_fft_size, d_n_harmonics);
+        d_samples.set_size(d_fft_size);
+        d_amp_scratch.resize(d_n_harmonics);
+      }
+    }
 
     /*
      * Our virtual destructor.
@@ -56,54 +163,185 @@ namespace gr {
       return 2.0 * PI * k / (float)d_fft_size;
     }
 
+    float harmonic_retrieval_impl::estimate_frequency(const gr_complex *fft, float &amplitude) {
+      // Locate the strongest bin (VOLK compares |z|^2, which has the same argmax as |z|)
+      uint32_t max_bin = 0;
+      volk_32fc_index_max_32u(&max_bin, fft, d_fft_size);
+      int k = max_bin;
+      amplitude = std::abs(fft[k]) / d_fft_size;
+
+      // cos_alpha_num = -z_k[k-1]*np.cos(beta_k(k-1)) + (1+r_k_1)*z_k[k]*np.cos(beta_k(k)) 
+      //               - r_k_1*z_k[k+1]*np.cos(beta_k(k+1))
+      // cos_alpha_den = -z_k[k-1] + (1+r_k_1)*z_k[k] - r_k_1*z_k[k+1]
+      int left = (k == 0) ? d_fft_size-1 : k-1;  // Loop around the fft[k-1] lookup
+      int right = (k == d_fft_size-1) ? 0 : k+1;  // Loop around the fft[k+1] lookup
+      gr_complex cos_alpha_num = -fft[left]*d_cos_beta[left] + ((float)1.0+d_r_k_1)*fft[k]*d_cos_beta[k] - d_r_k_1*fft[right]*d_cos_beta[right];
+      gr_complex cos_alpha_den = -fft[left] + ((float)1.0+d_r_k_1)*fft[k] - d_r_k_1*fft[right];
+
+      // f = np.arccos((cos_alpha_num / cos_alpha_den).real) / np.pi * self.samp_rate / 2
+      float cos_alpha = std::clamp((cos_alpha_num / cos_alpha_den).real(), (float)-1.0, (float)1.0);
+      return std::acos(cos_alpha) / PI * d_samp_rate / (float)2.0;
+    }
+
+    float harmonic_retrieval_impl::zoom_frequency(const gr_complex *fft, const gr_complex *samples, float &amplitude) {
+      int N = d_fft_size, M = d_zoom_points;
+
+      // Coarse peak from the full-resolution FFT
+      uint32_t k = 0;
+      volk_32fc_index_max_32u(&k, fft, N);
+      amplitude = std::abs(fft[k]) / N;
+      int start_bin = (k == 0) ? N-1 : k-1;
+
+      // Pre-chirp the samples and shift bin k-1 down to DC, zero-padding to the Bluestein length
+      gr_complex *czt_in = d_czt_fwd->get_inbuf();
+      volk_32fc_x2_multiply_32fc(czt_in, samples, d_czt_chirp.data(), N);
+      for (int n = 0, idx = 0; n < N; n++, idx = (idx + start_bin) % N) {
+        czt_in[n] *= d_twiddle[idx];
+      }
+      std::fill(czt_in + N, czt_in + d_czt_len, gr_complex(0.0, 0.0));
+
+      // Convolve with the precomputed chirp kernel
+      d_czt_fwd->execute();
+      volk_32fc_x2_multiply_32fc(d_czt_rev->get_inbuf(), d_czt_fwd->get_outbuf(), d_czt_kernel.data(), d_czt_len);
+      d_czt_rev->execute();
+
+      // The post-chirp only rotates phase, so the zoom peak can be read from the raw convolution output
+      const gr_complex *zoom = d_czt_rev->get_outbuf();
+      uint32_t m = 0;
+      volk_32fc_index_max_32u(&m, zoom, M);
+
+      // Parabolic interpolation between neighbouring zoom points
+      float offset = 0.0;
+      if (m > 0 && (int)m < M-1) {
+        float a = std::abs(zoom[m-1]), b = std::abs(zoom[m]), c = std::abs(zoom[m+1]);
+        float den = a - 2*b + c;
+        if (den != 0.0) offset = 0.5 * (a - c) / den;
+      }
+
+      // Report |f| like the three-bin estimator, which cannot tell positive from negative frequencies
+      float bin = start_bin + (m + offset) * (float)2.0 / M;
+      if (bin >= N/(float)2.0) bin -= N;
+      return std::abs(bin) * d_samp_rate / (float)N;
+    }
+
+    void harmonic_retrieval_impl::esprit(const gr_complex *samples, float *freqs, float *amps) {
+      int N = d_fft_size, L = d_subspace_len, K = d_n_harmonics;
+      int n_snapshots = N - L + 1;
+
+      // Sliding-window snapshots of this vector, then its forward-backward averaged covariance
+      for (int n = 0; n < N; n++) {
+        d_samples(n) = samples[n];
+      }
+      for (int s = 0; s < n_snapshots; s++) {
+        d_snapshots.col(s) = d_samples.subvec(s, s+L-1);
+      }
+      d_vec_cov = d_snapshots * d_snapshots.t() / (double)n_snapshots;
+
+      // Forward-backward average (J*conj(R)*J decorrelates coherent paths), folded into the recursive L x L
+      // covariance, which is the only state carried between vectors
+      for (int j = 0; j < L; j++) {
+        for (int i = 0; i < L; i++) {
+          gr_complexd fb = 0.5 * (d_vec_cov(i, j) + std::conj(d_vec_cov(L-1-i, L-1-j)));
+          d_cov(i, j) = d_cov_valid ? (double)d_forgetting * d_cov(i, j) + (1.0 - d_forgetting) * fb : fb;
+        }
+      }
+      d_cov_valid = true;
+
+      // Signal subspace = eigenvectors of the K largest eigenvalues (eig_sym sorts ascending)
+      arma::eig_sym(d_eigval, d_eigvec, d_cov);
+      d_signal = d_eigvec.cols(L-K, L-1);
+
+      // Rotational invariance between the two shifted sub-arrays: Es2 = Es1 * Phi
+      arma::solve(d_phi, d_signal.rows(0, L-2), d_signal.rows(1, L-1));
+      arma::eig_gen(d_poles, d_phi);
+
+      for (int i = 0; i < K; i++) {
+        d_omega[i] = std::arg(d_poles(i));
+      }
+      std::sort(d_omega.begin(), d_omega.end());
+
+      // Least-squares amplitude of each tone against the current vector
+      for (int i = 0; i < K; i++) {
+        for (int n = 0; n < N; n++) {
+          d_vander(n, i) = std::polar(1.0, d_omega[i] * n);
+        }
+      }
+      arma::solve(d_gains, d_vander, d_samples);
+
+      for (int i = 0; i < K; i++) {
+        freqs[i] = d_omega[i] / (2.0 * PI) * d_samp_rate;
+        amps[i] = std::abs(d_gains(i));
+      }
+    }
+
     int
     harmonic_retrieval_impl::general_work (int noutput_items,
                        gr_vector_int &ninput_items,
                        gr_vector_const_void_star &input_items,
                        gr_vector_void_star &output_items)
     {
-      auto in = static_cast<const gr_complex *>(input_items[0]);
-      auto out = static_cast<float *>(output_items[0]);
-      int n_packets = ninput_items[0];
-      std::vector<gr_complex> fft(d_fft_size);
-
-      for (int fft_i = 0; fft_i < n_packets; fft_i++) {
-        // Grab the first fft and put it into a vector
-        fft.clear();
-        for (int i = fft_i*d_fft_size; i < (fft_i+1)*d_fft_size; i++) {
-          fft.push_back(in[i]);
+      auto in = static_cast<const input_type *>(input_items[0]);
+      auto out = static_cast<output_type *>(output_items[0]);
+      auto out_amp = (output_items.size() > 1) ? static_cast<output_type *>(output_items[1]) : nullptr;
+      float amplitude;
+
+      // One frequency is produced for every fft_size input vector
+      int n_vecs = std::min(ninput_items[0], noutput_items);
+
+      for (int vec_i = 0; vec_i < n_vecs; vec_i++) {
+        const gr_complex *spectrum = in + vec_i*d_fft_size;
+        const gr_complex *samples = nullptr;
+
+        // ESPRIT works on the raw samples and never needs a spectrum
+        if (d_estimator == ESPRIT) {
+          if (!d_time_domain) {
+            std::memcpy(d_ifft->get_inbuf(), spectrum, sizeof(gr_complex)*d_fft_size);
+            d_ifft->execute();
+            volk_32fc_s32fc_multiply_32fc(d_ifft->get_inbuf(), d_ifft->get_outbuf(), gr_complex(1.0 / d_fft_size, 0.0), d_fft_size);
+            spectrum = d_ifft->get_inbuf();  // The scaled samples, reusing the already-consumed input buffer
+          }
+          float *amps = out_amp ? out_amp + vec_i*d_n_harmonics : d_amp_scratch.data();
+          esprit(spectrum, out + vec_i*d_n_harmonics, amps);
+          continue;
         }
 
-        auto r_k_1 = std::exp(-I * (float)2.0 * PI / (float)d_fft_size);
-        auto iter_argmax = std::max_element(fft.begin(), fft.end(), [](gr_complex &a, gr_complex &b) {
-          return abs(a) < abs(b);
-        });
-        // int k = std::distance(fft.begin(), iter_argmax);
-        int k = 0;
-
-        // cos_alpha_num = -z_k[k-1]*np.cos(beta_k(k-1)) + (1+r_k_1)*z_k[k]*np.cos(beta_k(k)) 
-        //               - r_k_1*z_k[k+1]*np.cos(beta_k(k+1))
-        // cos_alpha_den = -z_k[k-1] + (1+r_k_1)*z_k[k] - r_k_1*z_k[k+1]
-        
-        // TODO Check this left/right logic
-        int left = (k == 0) ? d_fft_size-1 : k-1;  // Loop around the fft[k-1] lookup
-        int right = (k == d_fft_size-1) ? 0 : k+1;  // Loop around the fft[k+1] lookup
-        gr_complex cos_alpha_num = -fft[left]*std::cos(beta(k-1.0)) + ((float)1.0+r_k_1)*fft[k]*std::cos(beta(k)) - r_k_1*fft[right]*std::cos(beta(k+1.0));
-        gr_complex cos_alpha_den = -fft[left] + ((float)1.0+r_k_1)*fft[k] - r_k_1*fft[right];
-
-        // f = np.arccos((cos_alpha_num / cos_alpha_den).real) / np.pi * self.samp_rate / 2
-        float freq = std::acos((cos_alpha_num / cos_alpha_den).real()) / PI * d_samp_rate / (float)2.0;
-
-        // Output many copies of this float
-        for (int i = 0; i < noutput_items; i++) {
-          out[i] = freq;
+        // Transform raw samples in the FFT's own buffer rather than through an upstream FFT block
+        if (d_time_domain) {
+          gr_complex *fft_in = d_fft->get_inbuf();
+          if (d_window.empty()) {
+            std::memcpy(fft_in, spectrum, sizeof(gr_complex)*d_fft_size);
+          } else {
+            volk_32fc_32f_multiply_32fc(fft_in, spectrum, d_window.data(), d_fft_size);
+          }
+          d_fft->execute();
+          samples = fft_in;  // Out-of-place FFT leaves the (windowed) samples intact
+          spectrum = d_fft->get_outbuf();
+        }
+
+        switch (d_estimator) {
+        case CHIRP_Z:
+          if (!d_time_domain) {
+            // An unscaled inverse FFT is fine here, only the location of the peak matters
+            std::memcpy(d_ifft->get_inbuf(), spectrum, sizeof(gr_complex)*d_fft_size);
+            d_ifft->execute();
+            samples = d_ifft->get_outbuf();
+          }
+          out[vec_i] = zoom_frequency(spectrum, samples, amplitude);
+          break;
+        case INTERP_3BIN:
+        default:
+          out[vec_i] = estimate_frequency(spectrum, amplitude);
+          break;
+        }
+        if (out_amp) {
+          out_amp[vec_i] = amplitude;
         }
       }
 
-      consume(0, noutput_items);
+      consume(0, n_vecs);
 
       // Tell runtime system how many output items we produced
-      return noutput_items;
+      return n_vecs;
     }
 
   } /* namespace radar_dsp */
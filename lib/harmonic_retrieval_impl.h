@@ -9,6 +9,10 @@
 #define INCLUDED_RADAR_DSP_HARMONIC_RETRIEVAL_IMPL_H
 
 #include <gnuradio/radar_dsp/harmonic_retrieval.h>
+#include <gnuradio/fft/fft.h>
+#include <armadillo>
+#include <vector>
+#include <memory>
 
 namespace gr {
   namespace radar_dsp {
@@ -17,11 +21,55 @@ namespace gr {
     {
      private:
       int d_samp_rate, d_fft_size;
+      bool d_time_domain;
+      std::vector<float> d_window;
+      estimator_t d_estimator;
+      std::unique_ptr<gr::fft::fft_complex_fwd> d_fft;  // Planned once, only used in time-domain mode
+      gr_complex d_r_k_1;               // exp(-j*2*pi/N), constant for a given fft_size
+      std::vector<float> d_cos_beta;    // cos(beta(k)) for every bin k, computed once
+
+      // Chirp-z (Bluestein) state, all sized at construction
+      int d_zoom_points, d_czt_len;
+      std::unique_ptr<gr::fft::fft_complex_rev> d_ifft;      // Recovers time samples from FFT'd input
+      std::unique_ptr<gr::fft::fft_complex_fwd> d_czt_fwd;
+      std::unique_ptr<gr::fft::fft_complex_rev> d_czt_rev;
+      std::vector<gr_complex> d_czt_chirp;    // exp(-j*delta*n^2/2), n = 0..N-1
+      std::vector<gr_complex> d_czt_kernel;   // FFT of exp(+j*delta*l^2/2), scaled by 1/L
+      std::vector<gr_complex> d_twiddle;      // exp(-j*2*pi*i/N), used to shift the zoom band onto the peak
+
+      // ESPRIT state
+      int d_n_harmonics, d_subspace_len;
+      float d_forgetting;
+      bool d_cov_valid;
+      arma::cx_mat d_cov;         // Recursive L x L sample covariance
+      arma::cx_mat d_vec_cov;     // L x L covariance of the current vector
+      arma::vec d_eigval;         // Eigen-decomposition workspaces, sized once for L and K
+      arma::cx_mat d_eigvec;
+      arma::cx_mat d_signal;      // L x K signal subspace
+      arma::cx_mat d_phi;         // K x K rotation between the shifted sub-arrays
+      arma::cx_vec d_poles;
+      std::vector<double> d_omega;  // Tone frequencies (rad/sample), ascending
+      arma::cx_vec d_gains;
+      arma::cx_mat d_snapshots;   // L x (N-L+1) sliding windows of the current vector
+      arma::cx_mat d_vander;      // N x K Vandermonde matrix for the amplitude fit
+      arma::cx_vec d_samples;
+      std::vector<float> d_amp_scratch;  // Amplitudes land here when output 1 is not connected
 
       inline float beta(float k);
 
+      // Interpolate the frequency of the strongest tone in one fft_size spectrum
+      float estimate_frequency(const gr_complex *fft, float &amplitude);
+
+      // Refine the peak of `fft` with a chirp-z transform of the matching time samples
+      float zoom_frequency(const gr_complex *fft, const gr_complex *samples, float &amplitude);
+
+      // Update the covariance with one vector of samples and write n_harmonics frequencies/amplitudes
+      void esprit(const gr_complex *samples, float *freqs, float *amps);
+
      public:
-      harmonic_retrieval_impl(int samp_rate, int fft_size);
+      harmonic_retrieval_impl(int samp_rate, int fft_size, bool time_domain, const std::vector<float>& window,
+                              estimator_t estimator, int zoom_points,
+                              int n_harmonics, int subspace_len, float forgetting);
       ~harmonic_retrieval_impl();
 
       void forecast (int noutput_items, gr_vector_int &ninput_items_required);
@@ -0,0 +1,97 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2023 Luke Jacobs.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include <gnuradio/io_signature.h>
+#include <gnuradio/math.h>
+#include "header_decoder_impl.h"
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+
+namespace gr {
+  namespace radar_dsp {
+
+    // Bits in the count_till_switch field
+    static const int COUNT_BITS = 32;
+
+    header_decoder::sptr header_decoder::make(int training_seq_len, int packet_len, float samp_rate)
+    {
+      return gnuradio::make_block_sptr<header_decoder_impl>(training_seq_len, packet_len, samp_rate);
+    }
+
+    /*
+     * The private constructor
+     */
+    header_decoder_impl::header_decoder_impl(int training_seq_len, int packet_len, float samp_rate)
+      : gr::sync_block("header_decoder",
+                       gr::io_signature::make3(3 /* min inputs */, 3 /* max inputs */, sizeof(gr_complex)*packet_len, sizeof(float), sizeof(gr_complex)),
+                       gr::io_signature::make(0 /* min outputs */, 1 /*max outputs */, sizeof(gr_complex)*packet_len)),
+        d_training_seq_len(training_seq_len),
+        d_packet_len(packet_len),
+        d_samp_rate(samp_rate),
+        d_eq_buf(packet_len)
+    {
+      if (packet_len < COUNT_BITS)
+        throw std::invalid_argument("header_decoder: packet_len must cover the 32-bit count field");
+      message_port_register_out(pmt::mp("header"));
+    }
+
+    /*
+     * Our virtual destructor.
+     */
+    header_decoder_impl::~header_decoder_impl() {}
+
+    int
+    header_decoder_impl::work(int noutput_items, gr_vector_const_void_star &input_items, gr_vector_void_star &output_items) {
+      auto packet_in = static_cast<const gr_complex *>(input_items[0]);
+      auto cfo_est_in = static_cast<const float *>(input_items[1]);
+      auto chan_est_in = static_cast<const gr_complex *>(input_items[2]);
+
+      for (int vec_i = 0; vec_i < noutput_items; vec_i++) {
+        const gr_complex* rx = packet_in + vec_i * d_packet_len;
+        gr_complex* eq = output_items.empty() ? &d_eq_buf.front() : static_cast<gr_complex *>(output_items[0]) + vec_i * d_packet_len;
+
+        // Undo the CFO (same sign and time origin as channel_estimator) and the channel rotation; the estimate is
+        // already the inverse rotation
+        double step = 2.0 * GR_M_PI * cfo_est_in[vec_i] / d_samp_rate;
+        gr_complex rot = chan_est_in[vec_i] * std::polar(1.0f, (float)std::remainder(step * d_training_seq_len, 2 * GR_M_PI));
+        gr_complex rot_step = std::polar(1.0f, (float)step);
+        for (int i = 0; i < d_packet_len; i++) {
+          eq[i] = rx[i] * rot;
+          rot *= rot_step;
+        }
+
+        // Slice the on-off keyed bits at half the strongest one
+        float peak = 0.0;
+        for (int bit_i = 0; bit_i < COUNT_BITS; bit_i++)
+          peak = std::max(peak, eq[bit_i].real());
+        float threshold = peak / 2;
+        uint32_t count = 0;
+        float margin = 1.0;
+        for (int bit_i = 0; bit_i < COUNT_BITS; bit_i++) {
+          if (eq[bit_i].real() > threshold)
+            count |= (uint32_t)1 << bit_i;
+          if (threshold > 0)
+            margin = std::min(margin, std::abs(eq[bit_i].real() - threshold) / threshold);
+        }
+        if (threshold <= 0)
+          margin = 0.0;
+
+        pmt::pmt_t header = pmt::make_dict();
+        header = pmt::dict_add(header, pmt::mp("count_till_switch"), pmt::from_long(count));
+        header = pmt::dict_add(header, pmt::mp("margin"), pmt::from_double(margin));
+        message_port_pub(pmt::mp("header"), header);
+        if (!output_items.empty())
+          add_item_tag(0, nitems_written(0) + vec_i, pmt::mp("count_till_switch"), pmt::from_long(count));
+      }
+
+      // Tell runtime system how many output items we produced.
+      return noutput_items;
+    }
+
+  } /* namespace radar_dsp */
+} /* namespace gr */
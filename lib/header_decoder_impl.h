@@ -0,0 +1,35 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2023 Luke Jacobs.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef INCLUDED_RADAR_DSP_HEADER_DECODER_IMPL_H
+#define INCLUDED_RADAR_DSP_HEADER_DECODER_IMPL_H
+
+#include <gnuradio/radar_dsp/header_decoder.h>
+
+namespace gr {
+  namespace radar_dsp {
+
+    class header_decoder_impl : public header_decoder
+    {
+     private:
+      int d_training_seq_len;
+      int d_packet_len;
+      float d_samp_rate;
+      std::vector<gr_complex> d_eq_buf;  // Equalized packet when the output is not connected
+
+     public:
+      header_decoder_impl(int training_seq_len, int packet_len, float samp_rate);
+      ~header_decoder_impl();
+
+      // Where all the action really happens
+      int work(int noutput_items, gr_vector_const_void_star &input_items, gr_vector_void_star &output_items);
+    };
+
+  } // namespace radar_dsp
+} // namespace gr
+
+#endif /* INCLUDED_RADAR_DSP_HEADER_DECODER_IMPL_H */
@@ -9,8 +9,6 @@
 #define INCLUDED_RADAR_DSP_LLS_IMPL_H
 
 #include <gnuradio/radar_dsp/lls.h>
-#define ARMA_DONT_USE_WRAPPER
-#include <armadillo>
 
 
 namespace gr {
@@ -21,7 +19,7 @@ namespace gr {
      private:
       float d_f_c;
       int d_n_tones;
-      arma::fcolvec d_f_i;
+      std::vector<float> d_f_i;
 
      public:
       lls_impl(float f_c, std::vector<float>& f_i, int n_tones);
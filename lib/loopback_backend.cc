@@ -0,0 +1,443 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2023 Luke Jacobs.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "loopback_backend.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <deque>
+#include <limits>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <volk/volk.h>
+
+namespace gr {
+namespace radar_dsp {
+
+static const double PI = 3.14159265358979323;
+
+// How long sent bursts stay on the air interface, and how far a receiver may fall behind before it overflows
+static const double RETENTION_SECONDS = 1.0;
+
+struct loopback_backend::burst {
+    int src;
+    double start;                       // True time of the first sample
+    double rate;                        // Transmitter's true sample rate
+    double freq;                        // Transmitter's carrier including its LO offset
+    std::vector<gr_complex> samples;
+    bool open;                          // Still being appended to (no end of burst yet)
+};
+
+struct loopback_backend::group {
+    std::chrono::steady_clock::time_point epoch;
+    std::mutex mutex;                   // Guards bursts
+    std::deque<std::shared_ptr<burst>> bursts;
+    int next_id = 0;
+
+    static std::shared_ptr<group> get(const std::string& name)
+    {
+        static std::mutex registry_mutex;
+        static std::map<std::string, std::weak_ptr<group>> registry;
+
+        std::lock_guard<std::mutex> lock(registry_mutex);
+        std::shared_ptr<group> g = registry[name].lock();
+        if (!g) {
+            g = std::make_shared<group>();
+            g->epoch = std::chrono::steady_clock::now();
+            registry[name] = g;
+        }
+        return g;
+    }
+};
+
+loopback_backend::loopback_backend(const uhd::device_addr_t& args)
+    : d_group(group::get(args.get("group", "default"))),
+      d_delay(args.cast<double>("delay", 0.0)),
+      d_cfo(args.cast<double>("cfo", 0.0)),
+      d_phase_noise(args.cast<double>("phase_noise", 0.0)),
+      d_noise(args.cast<double>("noise", 0.0)),
+      d_leakage(args.cast<double>("leakage", 0.0)),
+      d_clock_scale(1.0 + args.cast<double>("clock_ppm", 0.0) * 1e-6),
+      d_time_offset(0.0),
+      d_next_time_offset(0.0),
+      d_time_latch(std::numeric_limits<double>::infinity()),
+      d_rate(1e6),
+      d_tx_freq(0.0),
+      d_rx_freq(0.0),
+      d_has_command_time(false),
+      d_command_time(0.0),
+      d_streaming(false),
+      d_late_commands(0),
+      d_rx_next(0),
+      d_rx_remaining(-1),
+      d_rx_sc16(false),
+      d_rng(args.cast<unsigned>("seed", std::random_device()())),
+      d_gauss(0.0, std::sqrt(0.5) * d_noise),
+      d_pn_phase(0.0)
+{
+    std::lock_guard<std::mutex> lock(d_group->mutex);
+    d_id = d_group->next_id++;
+}
+
+loopback_backend::~loopback_backend()
+{
+    // Close a burst that was never ended so it can be pruned
+    std::lock_guard<std::mutex> lock(d_group->mutex);
+    if (d_tx_burst)
+        d_tx_burst->open = false;
+}
+
+double loopback_backend::true_now() const
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - d_group->epoch).count();
+}
+
+std::string loopback_backend::get_pp_string()
+{
+    std::ostringstream ss;
+    ss << "Loopback radio node " << d_id << ": delay " << d_delay << " s, CFO " << d_cfo << " Hz, phase noise "
+       << d_phase_noise << " rad, noise " << d_noise << ", clock " << (d_clock_scale - 1.0) * 1e6 << " ppm";
+    return ss.str();
+}
+
+void loopback_backend::set_time_next_pps(const uhd::time_spec_t& time)
+{
+    // The new time latches on the next PPS edge; until then the device keeps counting on the old one
+    double now = true_now();
+    d_time_offset = offset_at(now);
+    d_time_latch = std::floor(now) + 1.0;
+    d_next_time_offset = time.get_real_secs() - d_time_latch * d_clock_scale;
+}
+
+uhd::time_spec_t loopback_backend::get_time_now() { return uhd::time_spec_t(to_local(true_now())); }
+
+uhd::time_spec_t loopback_backend::get_time_last_pps() { return uhd::time_spec_t(to_local(std::floor(true_now()))); }
+
+void loopback_backend::set_command_time(const uhd::time_spec_t& time)
+{
+    std::lock_guard<std::mutex> lock(d_mutex);
+    d_has_command_time = true;
+    d_command_time = time.get_real_secs();
+}
+
+void loopback_backend::clear_command_time()
+{
+    std::lock_guard<std::mutex> lock(d_mutex);
+    d_has_command_time = false;
+}
+
+void loopback_backend::schedule_tune(std::vector<std::pair<double, double>>& tunes, double freq)
+{
+    double at = d_has_command_time ? d_command_time : -HUGE_VAL;
+    tunes.emplace_back(at, freq);
+}
+
+double loopback_backend::freq_at(std::vector<std::pair<double, double>>& tunes, double& freq, double local_time)
+{
+    // Apply every tune whose command time has passed (tunes are scheduled in time order)
+    auto due = tunes.begin();
+    while (due != tunes.end() && due->first <= local_time) {
+        freq = due->second;
+        due++;
+    }
+    tunes.erase(tunes.begin(), due);
+    return freq;
+}
+
+void loopback_backend::set_tx_freq(const uhd::tune_request_t& request, size_t chan)
+{
+    std::lock_guard<std::mutex> lock(d_mutex);
+    schedule_tune(d_tx_tunes, request.target_freq);
+}
+
+void loopback_backend::set_rx_freq(const uhd::tune_request_t& request, size_t chan)
+{
+    std::lock_guard<std::mutex> lock(d_mutex);
+    schedule_tune(d_rx_tunes, request.target_freq);
+}
+
+uhd::sensor_value_t loopback_backend::get_rx_sensor(const std::string& name, size_t chan)
+{
+    if (name != "lo_locked")
+        throw std::invalid_argument("Loopback radio: unknown sensor " + name);
+    return uhd::sensor_value_t(name, true, "locked", "unlocked");
+}
+
+uhd::sensor_value_t loopback_backend::get_tx_sensor(const std::string& name, size_t chan)
+{
+    return get_rx_sensor(name, chan);
+}
+
+void loopback_backend::setup_streams(const uhd::stream_args_t& rx_args, const uhd::stream_args_t& tx_args)
+{
+    if ((rx_args.cpu_format != "fc32" && rx_args.cpu_format != "sc16") || tx_args.cpu_format != "fc32")
+        throw std::invalid_argument("Loopback radio: only fc32 (and sc16 on RX) host formats are supported");
+    d_rx_sc16 = (rx_args.cpu_format == "sc16");
+    if (tx_args.channels.size() > 1)
+        throw std::invalid_argument("Loopback radio: only one TX channel is supported");
+}
+
+size_t loopback_backend::send(const gr_complex* buf, size_t n, const uhd::tx_metadata_t& md, double timeout)
+{
+    double now = true_now();
+    std::lock_guard<std::mutex> lock(d_group->mutex);
+
+    if (!d_tx_burst) {
+        if (n == 0)
+            return 0;
+        // Late bursts go out immediately instead of being dropped
+        double start = md.has_time_spec ? to_true(md.time_spec.get_real_secs()) : now;
+        std::lock_guard<std::mutex> node_lock(d_mutex);
+        if (start < now) {
+            uhd::async_metadata_t event;
+            event.channel = 0;
+            event.has_time_spec = true;
+            event.time_spec = uhd::time_spec_t(to_local(now));
+            event.event_code = uhd::async_metadata_t::EVENT_CODE_TIME_ERROR;
+            d_async.emplace_back(now, event);
+            start = now;
+        }
+        d_tx_burst = std::make_shared<burst>();
+        d_tx_burst->src = d_id;
+        d_tx_burst->start = start;
+        d_tx_burst->rate = d_rate * d_clock_scale;
+        d_tx_burst->freq = freq_at(d_tx_tunes, d_tx_freq, to_local(start)) + d_cfo;
+        d_tx_burst->open = true;
+        d_group->bursts.push_back(d_tx_burst);
+    }
+    d_tx_burst->samples.insert(d_tx_burst->samples.end(), buf, buf + n);
+    if (md.end_of_burst) {
+        double end = d_tx_burst->start + d_tx_burst->samples.size() / d_tx_burst->rate;
+        uhd::async_metadata_t event;
+        event.channel = 0;
+        event.has_time_spec = true;
+        event.time_spec = uhd::time_spec_t(to_local(end));
+        event.event_code = uhd::async_metadata_t::EVENT_CODE_BURST_ACK;
+        {
+            std::lock_guard<std::mutex> node_lock(d_mutex);
+            auto pos = std::upper_bound(d_async.begin(), d_async.end(), end,
+                                        [](double t, const std::pair<double, uhd::async_metadata_t>& e) { return t < e.first; });
+            d_async.emplace(pos, end, event);
+        }
+        d_tx_burst->open = false;
+        d_tx_burst.reset();
+    }
+
+    // Drop bursts that every receiver has moved past
+    auto& bursts = d_group->bursts;
+    while (!bursts.empty() && !bursts.front()->open &&
+           bursts.front()->start + bursts.front()->samples.size() / bursts.front()->rate <
+               now - RETENTION_SECONDS - d_delay)
+        bursts.pop_front();
+
+    return n;
+}
+
+void loopback_backend::mix(gr_complex* buf, size_t n, long long first)
+{
+    std::fill(buf, buf + n, gr_complex(0.0, 0.0));
+
+    double t0 = to_true(first / d_rate);
+    double dt = 1.0 / (d_rate * d_clock_scale);
+    double rx_freq;
+    {
+        std::lock_guard<std::mutex> lock(d_mutex);
+        rx_freq = freq_at(d_rx_tunes, d_rx_freq, first / d_rate) + d_cfo;
+    }
+
+    std::lock_guard<std::mutex> lock(d_group->mutex);
+    for (const auto& b : d_group->bursts) {
+        double df = b->freq - rx_freq;
+        long long len = b->samples.size();
+        bool own = b->src == d_id;
+        if ((own && d_leakage == 0.0) || std::fabs(df) > 0.5 * d_rate || len < 2)
+            continue;
+        double delay = own ? 0.0 : d_delay;
+        float gain = own ? d_leakage : 1.0;
+
+        // Position within the burst (in transmitted samples) of received sample i is p0 + i * dp
+        double p0 = (t0 - delay - b->start) * b->rate;
+        double dp = dt * b->rate;
+        long long i_first = std::max(0LL, (long long)std::ceil(-p0 / dp));
+        long long i_last = std::min((long long)n, (long long)std::ceil((len - 1 - p0) / dp));
+        if (i_first >= i_last)
+            continue;
+
+        // Carrier phase of the transmitter at the delayed time minus the receiver's LO phase
+        double t = t0 + i_first * dt;
+        double cycles = b->freq * (t - delay) - rx_freq * t;
+        std::complex<double> rot = std::polar(1.0, 2.0 * PI * (cycles - std::floor(cycles)));
+        std::complex<double> step = std::polar(1.0, 2.0 * PI * df * dt);
+
+        const gr_complex* s = &b->samples.front();
+        for (long long i = i_first; i < i_last; i++) {
+            double p = p0 + i * dp;
+            long long j = (long long)p;
+            float mu = p - j;
+            gr_complex samp = gain * (s[j] + mu * (s[j + 1] - s[j]));
+            buf[i] += samp * gr_complex(rot.real(), rot.imag());
+            rot *= step;
+        }
+    }
+
+    if (d_phase_noise > 0.0) {
+        std::normal_distribution<double> pn(0.0, d_phase_noise);
+        for (size_t i = 0; i < n; i++) {
+            d_pn_phase += pn(d_rng);
+            buf[i] *= std::polar(1.0f, (float)d_pn_phase);
+        }
+        d_pn_phase = std::remainder(d_pn_phase, 2.0 * PI);
+    }
+    if (d_noise > 0.0) {
+        for (size_t i = 0; i < n; i++)
+            buf[i] += gr_complex(d_gauss(d_rng), d_gauss(d_rng));
+    }
+}
+
+size_t loopback_backend::recv(const std::vector<void*>& bufs, size_t n, uhd::rx_metadata_t& md, double timeout)
+{
+    md.has_time_spec = false;
+    md.more_fragments = false;
+    md.start_of_burst = false;
+    md.end_of_burst = false;
+    md.out_of_sequence = false;
+    md.error_code = uhd::rx_metadata_t::ERROR_CODE_NONE;
+
+    std::chrono::steady_clock::time_point deadline =
+        std::chrono::steady_clock::now() +
+        std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(timeout));
+    long long start, remaining;
+    {
+        std::lock_guard<std::mutex> lock(d_mutex);
+        if (d_late_commands > 0) {
+            d_late_commands--;
+            md.error_code = uhd::rx_metadata_t::ERROR_CODE_LATE_COMMAND;
+            return 0;
+        }
+        start = d_streaming ? d_rx_next : -1;
+        remaining = d_rx_remaining;
+    }
+    if (start < 0) {
+        std::this_thread::sleep_until(deadline);
+        md.error_code = uhd::rx_metadata_t::ERROR_CODE_TIMEOUT;
+        return 0;
+    }
+    if (remaining >= 0)
+        n = std::min(n, (size_t)remaining);
+
+    // Pace to the sample clock: wait until all n samples exist (or the timeout passes)
+    long long available = (long long)std::floor(to_local(true_now()) * d_rate) - start;
+    if (available < (long long)n) {
+        std::chrono::steady_clock::time_point ready =
+            d_group->epoch + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                                 std::chrono::duration<double>(to_true((start + n) / d_rate)));
+        std::this_thread::sleep_until(std::min(ready, deadline));
+        available = (long long)std::floor(to_local(true_now()) * d_rate) - start;
+    }
+    if (available <= 0) {
+        md.error_code = uhd::rx_metadata_t::ERROR_CODE_TIMEOUT;
+        return 0;
+    }
+    if (available > RETENTION_SECONDS * d_rate) {
+        // Bursts this far back may already be gone, so skip ahead like the device does on overflow
+        std::lock_guard<std::mutex> lock(d_mutex);
+        d_rx_next = start + available;
+        md.error_code = uhd::rx_metadata_t::ERROR_CODE_OVERFLOW;
+        return 0;
+    }
+    n = std::min(n, (size_t)available);
+
+    // All RX channels share one antenna. sc16 is scaled like UHD does (1.0 -> 32767) and saturates.
+    if (d_rx_sc16) {
+        d_rx_scratch.resize(n);
+        mix(&d_rx_scratch.front(), n, start);
+        volk_32f_s32f_convert_16i((int16_t*)bufs[0], (const float*)&d_rx_scratch.front(), 32767.0, 2 * n);
+    } else {
+        mix(static_cast<gr_complex*>(bufs[0]), n, start);
+    }
+    size_t item_size = d_rx_sc16 ? 2 * sizeof(int16_t) : sizeof(gr_complex);
+    for (size_t i = 1; i < bufs.size(); i++)
+        std::memcpy(bufs[i], bufs[0], n * item_size);
+
+    md.has_time_spec = true;
+    md.time_spec = uhd::time_spec_t::from_ticks(start, d_rate);
+    std::lock_guard<std::mutex> lock(d_mutex);
+    d_rx_next = start + n;
+    if (d_rx_remaining > 0) {
+        d_rx_remaining -= n;
+        if (d_rx_remaining == 0) {
+            md.end_of_burst = true;
+            d_streaming = false;
+            next_stream_cmd(d_rx_next / d_rate);
+        }
+    }
+    return n;
+}
+
+bool loopback_backend::recv_async_msg(uhd::async_metadata_t& md, double timeout)
+{
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                                                           std::chrono::duration<double>(timeout));
+    while (true) {
+        std::chrono::steady_clock::time_point wake = deadline;
+        {
+            std::lock_guard<std::mutex> lock(d_mutex);
+            if (!d_async.empty()) {
+                if (d_async.front().first <= true_now()) {
+                    md = d_async.front().second;
+                    d_async.pop_front();
+                    return true;
+                }
+                wake = std::min(wake, d_group->epoch + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                                                           std::chrono::duration<double>(d_async.front().first)));
+            }
+        }
+        if (std::chrono::steady_clock::now() >= deadline)
+            return false;
+        std::this_thread::sleep_until(wake);
+    }
+}
+
+void loopback_backend::issue_stream_cmd(const uhd::stream_cmd_t& cmd)
+{
+    double now = to_local(true_now());
+    std::lock_guard<std::mutex> lock(d_mutex);
+
+    if (cmd.stream_mode == uhd::stream_cmd_t::STREAM_MODE_STOP_CONTINUOUS) {
+        d_streaming = false;
+        d_stream_cmds.clear();
+        return;
+    }
+    d_stream_cmds.push_back(cmd);
+    if (!d_streaming)
+        next_stream_cmd(now);
+}
+
+void loopback_backend::next_stream_cmd(double now)
+{
+    while (!d_streaming && !d_stream_cmds.empty()) {
+        uhd::stream_cmd_t cmd = d_stream_cmds.front();
+        d_stream_cmds.pop_front();
+        double start = now;
+        if (!cmd.stream_now) {
+            start = cmd.time_spec.get_real_secs();
+            if (start < now) {
+                d_late_commands++;
+                continue;
+            }
+        }
+        d_rx_next = (long long)std::ceil(start * d_rate);
+        d_rx_remaining = cmd.stream_mode == uhd::stream_cmd_t::STREAM_MODE_START_CONTINUOUS ? -1 : (long long)cmd.num_samps;
+        d_streaming = true;
+    }
+}
+
+} // namespace radar_dsp
+} // namespace gr
@@ -0,0 +1,133 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2023 Luke Jacobs.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef INCLUDED_RADAR_DSP_LOOPBACK_BACKEND_H
+#define INCLUDED_RADAR_DSP_LOOPBACK_BACKEND_H
+
+#include "radio_backend.h"
+#include <uhd/types/device_addr.hpp>
+#include <deque>
+#include <mutex>
+#include <random>
+#include <utility>
+#include <vector>
+
+namespace gr {
+namespace radar_dsp {
+
+/*
+ * Software Loopback Radio
+ * - Every backend created with the same "group" joins one simulated air interface. Bursts sent by one node are heard
+ *   by all other nodes of the group through a channel model; a node hears its own bursts only through leakage.
+ * - Time is the process' steady clock since the group was created, so receivers are paced at the configured sample
+ *   rate and timed sends, stream commands and tunes behave like on a USRP. A receiver that falls more than a second
+ *   behind reports an overflow. All nodes share a PPS at every whole second of true time, and set_time_next_pps()
+ *   only takes effect at the next one. Stream commands queue up behind a running NUM_SAMPS burst like on a device.
+ *   Every burst is acknowledged when its last sample has been sent; late bursts are reported as time errors and sent
+ *   immediately.
+ * - Device args (all optional, the channel parameters describe the receiving node):
+ *     group=<name>        air interface to join (default "default")
+ *     delay=<s>           propagation delay of every burst this node hears
+ *     cfo=<Hz>            LO offset of this node (applied on TX and RX, so a link sees cfo_tx - cfo_rx)
+ *     phase_noise=<rad>   standard deviation of the per-sample random-walk phase increment on RX
+ *     noise=<amplitude>   RMS amplitude of complex AWGN added on RX
+ *     clock_ppm=<ppm>     sample clock (and device time) offset of this node
+ *     leakage=<gain>      amplitude at which the node hears its own bursts, undelayed (default 0)
+ *     seed=<n>            random seed for phase noise and AWGN
+ * - Any number of RX channels can be streamed, in fc32 or sc16; they all hear the same antenna.
+ * - Bursts are heard when the two carriers are less than half the sample rate apart; the difference shows up as a
+ *   frequency offset, and the carrier phase includes the -2*pi*f*delay term that phase ranging measures.
+ */
+class loopback_backend : public radio_backend
+{
+public:
+    struct burst;
+    struct group;
+
+private:
+    std::shared_ptr<group> d_group;
+    int d_id;
+
+    double d_delay, d_cfo, d_phase_noise, d_noise, d_leakage;
+    double d_clock_scale;                 // 1 + clock_ppm * 1e-6
+    double d_time_offset;                 // Device time at true time zero
+    double d_next_time_offset;            // d_time_offset once the pending set_time_next_pps() has latched
+    double d_time_latch;                  // True time of the PPS edge that latches it (infinity when none is pending)
+    double d_rate;
+
+    std::mutex d_mutex;                   // Guards the tune tables, command time and stream state
+    double d_tx_freq, d_rx_freq;
+    std::vector<std::pair<double, double>> d_tx_tunes, d_rx_tunes;  // Pending (device time, frequency)
+    bool d_has_command_time;
+    double d_command_time;
+
+    bool d_streaming;
+    int d_late_commands;                  // Late stream commands not yet reported
+    std::deque<uhd::stream_cmd_t> d_stream_cmds;  // Commands waiting for the current NUM_SAMPS burst to finish
+    long long d_rx_next;                  // Device-time sample index of the next received sample
+    long long d_rx_remaining;             // Samples left in a NUM_SAMPS burst, -1 when continuous
+    std::shared_ptr<burst> d_tx_burst;    // Burst currently being sent
+    std::deque<std::pair<double, uhd::async_metadata_t>> d_async;  // TX events by the true time they occur
+
+    bool d_rx_sc16;                       // RX host format is sc16 instead of fc32
+    std::vector<gr_complex> d_rx_scratch; // fc32 samples before the sc16 conversion
+
+    std::mt19937 d_rng;
+    std::normal_distribution<float> d_gauss;
+    double d_pn_phase;
+
+    double true_now() const;
+    double offset_at(double true_time) const { return true_time >= d_time_latch ? d_next_time_offset : d_time_offset; }
+    double to_local(double true_time) const { return true_time * d_clock_scale + offset_at(true_time); }
+    double to_true(double local_time) const { return (local_time - offset_at(true_now())) / d_clock_scale; }
+    double freq_at(std::vector<std::pair<double, double>>& tunes, double& freq, double local_time);
+    void schedule_tune(std::vector<std::pair<double, double>>& tunes, double freq);
+    void mix(gr_complex* buf, size_t n, long long first);  // Air interface as heard from sample `first` on
+    void next_stream_cmd(double now);     // Starts queued stream commands once the device is idle at time `now`
+
+public:
+    loopback_backend(const uhd::device_addr_t& args);
+    ~loopback_backend();
+
+    std::string get_pp_string() override;
+
+    void set_clock_source(const std::string& source) override {}
+    void set_time_source(const std::string& source) override {}
+    void set_time_next_pps(const uhd::time_spec_t& time) override;
+    uhd::time_spec_t get_time_now() override;
+    uhd::time_spec_t get_time_last_pps() override;
+    void set_command_time(const uhd::time_spec_t& time) override;
+    void clear_command_time() override;
+
+    void set_rx_subdev_spec(const std::string& spec) override {}
+    void set_tx_gain(double gain, size_t chan) override {}
+    void set_rx_gain(double gain, size_t chan) override {}
+    void set_tx_rate(double rate, size_t chan) override { d_rate = rate; }
+    void set_rx_rate(double rate, size_t chan) override { d_rate = rate; }
+    double get_tx_rate(size_t chan) override { return d_rate; }
+    double get_rx_rate(size_t chan) override { return d_rate; }
+    void set_tx_freq(const uhd::tune_request_t& request, size_t chan) override;
+    void set_rx_freq(const uhd::tune_request_t& request, size_t chan) override;
+
+    // The simulated LO is locked at all times
+    std::vector<std::string> get_rx_sensor_names(size_t chan) override { return { "lo_locked" }; }
+    std::vector<std::string> get_tx_sensor_names(size_t chan) override { return { "lo_locked" }; }
+    uhd::sensor_value_t get_rx_sensor(const std::string& name, size_t chan) override;
+    uhd::sensor_value_t get_tx_sensor(const std::string& name, size_t chan) override;
+
+    void setup_streams(const uhd::stream_args_t& rx_args, const uhd::stream_args_t& tx_args) override;
+    size_t get_max_num_samps() override { return 2000; }  // About one jumbo frame of sc16 samples
+    size_t send(const gr_complex* buf, size_t n, const uhd::tx_metadata_t& md, double timeout) override;
+    size_t recv(const std::vector<void*>& bufs, size_t n, uhd::rx_metadata_t& md, double timeout) override;
+    void issue_stream_cmd(const uhd::stream_cmd_t& cmd) override;
+    bool recv_async_msg(uhd::async_metadata_t& md, double timeout) override;
+};
+
+} // namespace radar_dsp
+} // namespace gr
+
+#endif /* INCLUDED_RADAR_DSP_LOOPBACK_BACKEND_H */
@@ -0,0 +1,83 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2023 Luke Jacobs.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "modulator_impl.h"
+#include <gnuradio/io_signature.h>
+#include <algorithm>
+#include <stdexcept>
+
+namespace gr {
+namespace radar_dsp {
+
+modulator::sptr modulator::make(int bits_per_symbol, int samps_per_sym, float excess_bw)
+{
+    return gnuradio::make_block_sptr<modulator_impl>(bits_per_symbol, samps_per_sym, excess_bw);
+}
+
+static pulse_modulator::modulation modulation_for(int bits_per_symbol)
+{
+  if (bits_per_symbol == 1)
+    return pulse_modulator::BPSK;
+  if (bits_per_symbol == 2)
+    return pulse_modulator::QPSK;
+  throw std::invalid_argument("modulator: bits_per_symbol must be 1 (BPSK) or 2 (QPSK)");
+}
+
+// Output samples per input byte (validates the arguments before the base class divides by them)
+static unsigned interpolation_for(int bits_per_symbol, int samps_per_sym)
+{
+  modulation_for(bits_per_symbol);
+  if (samps_per_sym < 1)
+    throw std::invalid_argument("modulator: samps_per_sym must be positive");
+  return 8 / bits_per_symbol * samps_per_sym;
+}
+
+/*
+ * The private constructor
+ * - The history holds enough past bytes to cover the pulse, so every output only depends on the input.
+ * - The scheduler primes the history with zero bytes, which are not data (a zero byte is eight BPSK -1 symbols).
+ *   work() maps them to silence, so the stream starts with the pulse of the first real byte.
+ */
+modulator_impl::modulator_impl(int bits_per_symbol, int samps_per_sym, float excess_bw)
+    : gr::sync_interpolator("modulator",
+                            gr::io_signature::make(1 /* min inputs */, 1 /* max inputs */, sizeof(uint8_t)),
+                            gr::io_signature::make(1 /* min outputs */, 1 /*max outputs */, sizeof(gr_complex)),
+                            interpolation_for(bits_per_symbol, samps_per_sym)),
+      d_modulator(modulation_for(bits_per_symbol), samps_per_sym, excess_bw)
+{
+  const int syms_per_byte = d_modulator.symbols_per_byte();
+  set_history(1 + (d_modulator.history() + syms_per_byte - 1) / syms_per_byte);
+}
+
+/*
+ * Our virtual destructor.
+ */
+modulator_impl::~modulator_impl() {}
+
+int modulator_impl::work(int noutput_items,
+                         gr_vector_const_void_star& input_items,
+                         gr_vector_void_star& output_items)
+{
+  auto in = static_cast<const uint8_t *>(input_items[0]);
+  auto out = static_cast<gr_complex *>(output_items[0]);
+
+  const int syms_per_byte = d_modulator.symbols_per_byte();
+  const int ninput_items = noutput_items / interpolation();
+  const int nhist = history() - 1;
+  d_syms.resize((nhist + ninput_items) * syms_per_byte);
+  d_modulator.map(in, nhist + ninput_items, &d_syms.front());
+  const uint64_t nread = nitems_read(0);
+  if (nread < (uint64_t)nhist)
+    std::fill(d_syms.begin(), d_syms.begin() + (nhist - nread) * syms_per_byte, gr_complex(0.0, 0.0));
+  d_modulator.shape_steady(&d_syms[nhist * syms_per_byte], ninput_items * syms_per_byte, out);
+
+  // Tell runtime system how many output items we produced.
+  return noutput_items;
+}
+
+} /* namespace radar_dsp */
+} /* namespace gr */
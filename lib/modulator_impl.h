@@ -0,0 +1,35 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2023 Luke Jacobs.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef INCLUDED_RADAR_DSP_MODULATOR_IMPL_H
+#define INCLUDED_RADAR_DSP_MODULATOR_IMPL_H
+
+#include <gnuradio/radar_dsp/modulator.h>
+#include "pulse_modulator.h"
+
+namespace gr {
+  namespace radar_dsp {
+
+    class modulator_impl : public modulator
+    {
+     private:
+      pulse_modulator d_modulator;
+      std::vector<gr_complex> d_syms;  // Symbols of the history bytes followed by the new ones
+
+     public:
+      modulator_impl(int bits_per_symbol, int samps_per_sym, float excess_bw);
+      ~modulator_impl();
+
+      int work(int noutput_items,
+               gr_vector_const_void_star &input_items,
+               gr_vector_void_star &output_items);
+    };
+
+  } // namespace radar_dsp
+} // namespace gr
+
+#endif /* INCLUDED_RADAR_DSP_MODULATOR_IMPL_H */
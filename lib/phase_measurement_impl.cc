@@ -7,15 +7,11 @@
 
 #include <gnuradio/io_signature.h>
 #include "phase_measurement_impl.h"
-#define ARMA_DONT_USE_WRAPPER
-#include <armadillo>
+#include "ranging_kernels.h"
 
 namespace gr {
   namespace radar_dsp {
 
-    static const gr_complexd I(0.0, 1.0);
-    static const double PI = 3.14159265358979323;  // std::acos(-1);
-
     phase_measurement::sptr phase_measurement::make(std::vector<float>& tone_frequencies, int n_tones, int vector_length, float samp_rate)
     {
       return gnuradio::make_block_sptr<phase_measurement_impl>(tone_frequencies, n_tones, vector_length, samp_rate);
@@ -63,24 +59,9 @@ namespace gr {
       // exponentials of frequency equal to the elements of `tone_frequencies` plus
       // cfo
       for (int samp_i = 0; samp_i < ninput_items[0]; samp_i++) {
-        // Take the samples from the input as a vector
-        arma::cx_dvec rx_buf(d_vector_length);
-        for (int i = 0; i < d_vector_length; i++) {
-          rx_buf(i) = in_samples[samp_i*d_vector_length + i];
-        }
-
-        arma::cx_dvec arange(d_vector_length);
-        for (int i = 0; i < d_vector_length; i++) arange(i) = i;
-
-        // For each tone frequency, compute the initial phase of that tone given the
-        // RX buffer
-        for (int tone_i = 0; tone_i < d_n_tones; tone_i++) {
-          float freq_with_cfo = d_tone_frequencies[tone_i] - in_cfo[samp_i];
-          arma::cx_dvec complex_tone = arma::exp(I * 2.0 * PI * arange * freq_with_cfo / d_samp_rate);  // TODO Check type conversions
-          gr_complexd corr_sum = arma::sum(complex_tone.t() * rx_buf);
-          float phase_i = std::arg(corr_sum);
-          out_phases[samp_i*d_n_tones + tone_i] = phase_i;  // We write the phases in "vectors" of length d_n_tones
-        }
+        // We write the phases in "vectors" of length d_n_tones
+        measure_tone_phases(in_samples + samp_i * d_vector_length, d_vector_length, d_tone_frequencies.data(), d_n_tones,
+                            in_cfo[samp_i], d_samp_rate, out_phases + samp_i * d_n_tones);
       }
 
       // TODO Correct phases if one is looped around (holding to the short-distance assumption)
@@ -8,37 +8,56 @@
 #include "pulse_align_impl.h"
 #include <gnuradio/io_signature.h>
 #include <gnuradio/filter/firdes.h>
-#include <armadillo>
-#include "usrp_tx_rx_impl.h"  // TODO Hopefully the linking with the usrp_tx_rx block won't be a problem
+#include <volk/volk.h>
+#include <algorithm>
+#include <cstring>
+#include <cassert>
+#include <cstdio>
+#include <stdexcept>
+
+#ifdef GR_CTRLPORT
+#include <gnuradio/rpcregisterhelpers.h>
+#endif
 
 namespace gr {
 namespace radar_dsp {
 
-/*
- * Downsampling
- */
-std::vector<gr_complex> downsample(const std::vector<gr_complex>::iterator in_start, 
-                                   const std::vector<gr_complex>::iterator in_end, 
-                                   int downsampling_rate) {
-    assert(downsampling_rate > 0);
-    double input_len = std::distance(in_start, in_end);
-    std::vector<gr_complex> out(std::ceil(input_len / downsampling_rate));
-
-    for (int i = 0; i < out.size(); i++) {
-        out[i] = *(in_start + i*downsampling_rate);
-    }
-    return out;
-}
+// In streaming mode, re-evaluate the phase early if the symbols' average magnitude falls below this fraction
+// of what it was at the last evaluation
+static const float DRIFT_FRACTION = 0.8;
+
+// Arms in the timing recovery filterbank, i.e. the strobe resolution is 1/32 of a sample
+static const int TIMING_NFILTS = 32;
 
-pulse_align::sptr pulse_align::make(int input_buffer_len, float samp_rate, int samps_per_sym)
+// Shortest interval between two statistics reports (message and optional console line)
+static const std::chrono::seconds STATS_PERIOD(1);
+
+pulse_align::sptr pulse_align::make(int input_buffer_len,
+                                    float samp_rate,
+                                    int samps_per_sym,
+                                    bool streaming,
+                                    int reeval_interval,
+                                    timing_t timing,
+                                    float loop_bw,
+                                    bool verbose,
+                                    float excess_bw)
 {
-    return gnuradio::make_block_sptr<pulse_align_impl>(input_buffer_len, samp_rate, samps_per_sym);
+    return gnuradio::make_block_sptr<pulse_align_impl>(
+        input_buffer_len, samp_rate, samps_per_sym, streaming, reeval_interval, timing, loop_bw, verbose, excess_bw);
 }
 
 /*
  * The private constructor
  */
-pulse_align_impl::pulse_align_impl(int input_buffer_len, float samp_rate, int samps_per_sym)
+pulse_align_impl::pulse_align_impl(int input_buffer_len,
+                                   float samp_rate,
+                                   int samps_per_sym,
+                                   bool streaming,
+                                   int reeval_interval,
+                                   timing_t timing,
+                                   float loop_bw,
+                                   bool verbose,
+                                   float excess_bw)
     : gr::block("pulse_align",
                 gr::io_signature::make(
                     1 /* min inputs */, 1 /* max inputs */, input_buffer_len*sizeof(gr_complex)),
@@ -46,9 +65,64 @@ pulse_align_impl::pulse_align_impl(int input_buffer_len, float samp_rate, int sa
                     1 /* min outputs */, 1 /*max outputs */, sizeof(gr_complex))),
                 d_input_buffer_len(input_buffer_len),
                 d_samps_per_sym(samps_per_sym),
-                d_samp_rate(samp_rate)
+                d_samp_rate(samp_rate),
+                d_streaming(streaming),
+                d_next_sym(0),
+                d_reeval_interval(std::max(1, reeval_interval)),
+                d_vecs_since_eval(0),
+                d_ref_energy(0.0),
+                d_phase_valid(false),
+                d_verbose(verbose),
+                d_calls(0),
+                d_vectors(0),
+                d_shift_hist(samps_per_sym, 0),
+                d_margin_sum(0.0),
+                d_margin_count(0),
+                d_last_report(std::chrono::steady_clock::now())
 {
     assert(d_samps_per_sym <= d_input_buffer_len);
+    if (excess_bw <= 0 || excess_bw > 1) {
+        throw std::invalid_argument("pulse_align: excess bandwidth must be in (0, 1]");
+    }
+
+    // Design the RRC matched filter once; redesigning it per vector cost more than the convolution
+    d_taps = filter::firdes::root_raised_cosine(1.0, d_samp_rate, d_samp_rate / d_samps_per_sym, excess_bw, 11*d_samps_per_sym);
+
+    // Every input vector is filtered on its own, so one FFT of at least N+T-1 points holds the whole "full" convolution.
+    // In streaming mode the same length holds the T-1 samples of history followed by the N new ones (overlap-save).
+    d_conv_len = d_input_buffer_len + d_taps.size() - 1;
+    d_fft_len = 1;
+    while (d_fft_len < d_conv_len) d_fft_len <<= 1;
+    d_fwd = std::make_unique<gr::fft::fft_complex_fwd>(d_fft_len);
+    d_rev = std::make_unique<gr::fft::fft_complex_rev>(d_fft_len);
+
+    gr_complex* fft_in = d_fwd->get_inbuf();
+    std::fill(fft_in, fft_in + d_fft_len, gr_complex(0.0, 0.0));
+    std::copy(d_taps.begin(), d_taps.end(), fft_in);
+    d_fwd->execute();
+    d_taps_fft.assign(d_fwd->get_outbuf(), d_fwd->get_outbuf() + d_fft_len);
+    for (auto& h : d_taps_fft)
+        h /= (float)d_fft_len;  // Fold the inverse FFT normalization into the taps
+
+    // Phase 0 always has the most samples, ceil(len / sps) of them. A streaming vector only yields its N valid samples.
+    int out_len = d_streaming ? d_input_buffer_len : d_conv_len;
+    d_max_syms_per_vec = (out_len + d_samps_per_sym - 1) / d_samps_per_sym;
+
+    // The timing loop does its own interpolating matched filtering, always as one continuous stream
+    if (timing != ENERGY_SEARCH) {
+        std::vector<float> prototype = filter::firdes::root_raised_cosine(
+            TIMING_NFILTS, TIMING_NFILTS * d_samp_rate, d_samp_rate / d_samps_per_sym, excess_bw, 11 * d_samps_per_sym * TIMING_NFILTS);
+        d_timing_recovery = std::make_unique<timing_recovery>(
+            timing == GARDNER ? timing_recovery::GARDNER : timing_recovery::MUELLER_MULLER,
+            d_samps_per_sym, prototype, TIMING_NFILTS, loop_bw);
+        d_max_syms_per_vec = d_timing_recovery->max_symbols(d_input_buffer_len);
+    }
+    set_output_multiple(d_max_syms_per_vec);
+    d_mag.resize(d_conv_len);
+    d_phase_energy.resize(d_samps_per_sym);
+    d_history.assign(d_taps.size() - 1, gr_complex(0.0, 0.0));
+
+    message_port_register_out(pmt::mp("stats"));
 }
 
 /*
@@ -56,9 +130,168 @@ pulse_align_impl::pulse_align_impl(int input_buffer_len, float samp_rate, int sa
  */
 pulse_align_impl::~pulse_align_impl() {}
 
+const gr_complex* pulse_align_impl::matched_filter(const gr_complex* vec)
+{
+    gr_complex* fft_in = d_fwd->get_inbuf();
+    std::memcpy(fft_in, vec, d_input_buffer_len * sizeof(gr_complex));
+    std::fill(fft_in + d_input_buffer_len, fft_in + d_fft_len, gr_complex(0.0, 0.0));
+    d_fwd->execute();
+
+    volk_32fc_x2_multiply_32fc(d_rev->get_inbuf(), d_fwd->get_outbuf(), d_taps_fft.data(), d_fft_len);
+    d_rev->execute();
+
+    return d_rev->get_outbuf();
+}
+
+const gr_complex* pulse_align_impl::matched_filter_stream(const gr_complex* vec)
+{
+    int n_hist = d_history.size();
+    gr_complex* fft_in = d_fwd->get_inbuf();
+    std::copy(d_history.begin(), d_history.end(), fft_in);
+    std::memcpy(fft_in + n_hist, vec, d_input_buffer_len * sizeof(gr_complex));
+    std::fill(fft_in + d_conv_len, fft_in + d_fft_len, gr_complex(0.0, 0.0));
+
+    // The tail of [history, vec] becomes the history of the next vector
+    std::copy(fft_in + d_input_buffer_len, fft_in + d_conv_len, d_history.begin());
+    d_fwd->execute();
+
+    volk_32fc_x2_multiply_32fc(d_rev->get_inbuf(), d_fwd->get_outbuf(), d_taps_fft.data(), d_fft_len);
+    d_rev->execute();
+
+    // The first T-1 outputs only cover history that was already produced by the previous vector
+    return d_rev->get_outbuf() + n_hist;
+}
+
+int pulse_align_impl::pick_phase(const gr_complex* buf, int n, int first, float& best_avg_energy, float& second_avg_energy)
+{
+    // Sample j belongs to phase (j - first) % sps, so one pass over the magnitudes
+    // accumulates the energy of every candidate decimation phase at once
+    volk_32fc_magnitude_32f(d_mag.data(), buf, n);
+    std::fill(d_phase_energy.begin(), d_phase_energy.end(), 0.0);
+    for (int j = 0, phase = (d_samps_per_sym - first % d_samps_per_sym) % d_samps_per_sym; j < n; j++) {
+        d_phase_energy[phase] += d_mag[j];
+        if (++phase == d_samps_per_sym) phase = 0;
+    }
+
+    // Compare the average energy output of decimation at each possible shift (0...N-1)
+    best_avg_energy = 0.0;
+    second_avg_energy = 0.0;
+    int best_shift = 0;
+    for (int shift = 0; shift < d_samps_per_sym; shift++) {
+        int first_sample = (first + shift) % d_samps_per_sym;
+        int n_syms = (n - first_sample + d_samps_per_sym - 1) / d_samps_per_sym;
+        if (n_syms < 1) continue;
+        float avg_energy = d_phase_energy[shift] / n_syms;
+        if (avg_energy > best_avg_energy) {
+            second_avg_energy = best_avg_energy;
+            best_avg_energy = avg_energy;
+            best_shift = shift;
+        } else if (avg_energy > second_avg_energy) {
+            second_avg_energy = avg_energy;
+        }
+    }
+    record_shift(best_shift, best_avg_energy, second_avg_energy);
+    return best_shift;
+}
+
+int pulse_align_impl::align_vector(const gr_complex* vec, gr_complex* out)
+{
+    // Convolve buffer with matched filter
+    const gr_complex* buf = matched_filter(vec);
+
+    float best_avg_energy, second_avg_energy;
+    int best_shift = pick_phase(buf, d_conv_len, 0, best_avg_energy, second_avg_energy);
+
+    // Decimate the winning phase straight into the output buffer
+    int n_out = 0;
+    for (int i = best_shift; i < d_conv_len; i += d_samps_per_sym) {
+        out[n_out++] = buf[i];
+    }
+    return n_out;
+}
+
+int pulse_align_impl::align_stream(const gr_complex* vec, gr_complex* out)
+{
+    const gr_complex* buf = matched_filter_stream(vec);
+
+    // Only search all phases periodically, or when the current phase has visibly lost energy
+    bool reeval = !d_phase_valid || (++d_vecs_since_eval >= d_reeval_interval);
+    if (!reeval) {
+        float energy = 0.0;
+        int n_syms = 0;
+        for (int i = d_next_sym; i < d_input_buffer_len; i += d_samps_per_sym, n_syms++) {
+            energy += std::abs(buf[i]);
+        }
+        reeval = (n_syms > 0) && (energy / n_syms < DRIFT_FRACTION * d_ref_energy);
+    }
+
+    if (reeval) {
+        float second_avg_energy;
+        int shift = pick_phase(buf, d_input_buffer_len, d_next_sym, d_ref_energy, second_avg_energy);
+        // Move by the shortest way round so that at most one symbol is skipped or repeated
+        if (shift > d_samps_per_sym / 2) shift -= d_samps_per_sym;
+        d_next_sym += shift;
+        if (d_next_sym < 0) d_next_sym += d_samps_per_sym;
+        d_vecs_since_eval = 0;
+        d_phase_valid = true;
+    }
+
+    int n_out = 0;
+    for (; d_next_sym < d_input_buffer_len; d_next_sym += d_samps_per_sym) {
+        out[n_out++] = buf[d_next_sym];
+    }
+    d_next_sym -= d_input_buffer_len;  // Carry the symbol phase into the next vector
+    return n_out;
+}
+
+void pulse_align_impl::record_shift(int shift, float best_avg_energy, float second_avg_energy)
+{
+    d_shift_hist[shift]++;
+    if (second_avg_energy > 0.0) {
+        d_margin_sum += best_avg_energy / second_avg_energy;
+        d_margin_count++;
+    }
+}
+
+void pulse_align_impl::report_stats()
+{
+    auto now = std::chrono::steady_clock::now();
+    if (now - d_last_report < STATS_PERIOD)
+        return;
+    d_last_report = now;
+
+    pmt::pmt_t stats = pmt::make_dict();
+    stats = pmt::dict_add(stats, pmt::mp("calls"), pmt::from_uint64(d_calls));
+    stats = pmt::dict_add(stats, pmt::mp("vectors"), pmt::from_uint64(d_vectors));
+    stats = pmt::dict_add(stats, pmt::mp("shift_hist"), pmt::init_u64vector(d_shift_hist.size(), d_shift_hist));
+    stats = pmt::dict_add(stats, pmt::mp("energy_margin"), pmt::from_double(energy_margin()));
+    message_port_pub(pmt::mp("stats"), stats);
+
+    if (d_verbose) {
+        std::printf("[pulse_align] calls=%llu vectors=%llu energy_margin=%.3f\n",
+                    (unsigned long long)d_calls, (unsigned long long)d_vectors, energy_margin());
+    }
+}
+
+void pulse_align_impl::setup_rpc()
+{
+#ifdef GR_CTRLPORT
+    add_rpc_variable(rpcbasic_sptr(new rpcbasic_register_get<pulse_align, long>(
+        alias(), "calls", &pulse_align::calls,
+        pmt::mp(0L), pmt::mp(0L), pmt::mp(0L), "", "general_work calls", RPC_PRIVLVL_MIN, DISPTIME)));
+    add_rpc_variable(rpcbasic_sptr(new rpcbasic_register_get<pulse_align, long>(
+        alias(), "vectors_processed", &pulse_align::vectors_processed,
+        pmt::mp(0L), pmt::mp(0L), pmt::mp(0L), "", "Input vectors processed", RPC_PRIVLVL_MIN, DISPTIME)));
+    add_rpc_variable(rpcbasic_sptr(new rpcbasic_register_get<pulse_align, double>(
+        alias(), "energy_margin", &pulse_align::energy_margin,
+        pmt::mp(0.0), pmt::mp(100.0), pmt::mp(1.0), "", "Best / second-best shift energy", RPC_PRIVLVL_MIN, DISPTIME)));
+#endif
+}
+
 void pulse_align_impl::forecast(int noutput_items, gr_vector_int& ninput_items_required)
 {
-    ninput_items_required[0] = noutput_items;
+    // Each vector needs room for up to d_max_syms_per_vec output symbols
+    ninput_items_required[0] = std::max(1, noutput_items / d_max_syms_per_vec);
 }
 
 int pulse_align_impl::general_work(int noutput_items,
@@ -70,36 +303,22 @@ int pulse_align_impl::general_work(int noutput_items,
     auto out = static_cast<gr_complex *>(output_items[0]);
     int vec_i, out_written = 0;
 
-    std::cout << "PulseAlign ninput_items[0] = " << ninput_items[0] << std::endl;
-    for (vec_i = 0; vec_i < ninput_items[0]; vec_i++) {  // TODO Check to see if ninput_items treats a input_buffer_len length vector as 1 item
-        // Convolve buffer with matched filter
-        std::vector<gr_complex> buf(in+vec_i*d_input_buffer_len, in+(vec_i+1)*d_input_buffer_len);        
-        buf = rrc_filter(buf, d_samp_rate, d_samps_per_sym, 11*d_samps_per_sym);
-
-        // Compare the average energy output of decimation at each possible shift (0...N-1)
-        float best_avg_energy = 0.0;
-        int best_shift = 0;
-
-        for (int shift = 0; shift < d_samps_per_sym; shift++) {
-            auto dec_buf = downsample(buf.begin()+shift, buf.end(), d_samps_per_sym);
-            float energy = 0.0;
-            std::for_each(dec_buf.begin(), dec_buf.end(), [&energy](gr_complex samp){energy += std::abs(samp);});
-            float avg_energy = energy / dec_buf.size();
-            // Update the best shift record if this is a better shift than the previous best
-            if (avg_energy > best_avg_energy) {
-                best_avg_energy = avg_energy;
-                best_shift = shift;
-                // std::cout << "Found better shift " << best_shift << " with energy " << avg_energy << std::endl;
-            }
+    for (vec_i = 0; vec_i < ninput_items[0] && out_written + d_max_syms_per_vec <= noutput_items; vec_i++) {
+        const gr_complex* vec = in + vec_i*d_input_buffer_len;
+        if (d_timing_recovery) {
+            out_written += d_timing_recovery->process(vec, d_input_buffer_len, out + out_written, noutput_items - out_written);
+        } else if (d_streaming) {
+            out_written += align_stream(vec, out + out_written);
+        } else {
+            out_written += align_vector(vec, out + out_written);
         }
-
-        auto out_vec = downsample(buf.begin()+best_shift, buf.end(), d_samps_per_sym);
-        std::copy(out_vec.begin(), out_vec.end(), out+out_written);
-        out_written += out_vec.size();
     }
 
+    d_calls++;
+    d_vectors += vec_i;
+    report_stats();
+
     // Tell runtime system how many input items we consumed on each input stream.
-    // std::cout << "Wrote " << out_written << " items\n";
     consume(0, vec_i);
 
     // Tell runtime system how many output samples we produced.
@@ -9,6 +9,11 @@
 #define INCLUDED_RADAR_DSP_PULSE_ALIGN_IMPL_H
 
 #include <gnuradio/radar_dsp/pulse_align.h>
+#include <gnuradio/fft/fft.h>
+#include <memory>
+#include <chrono>
+#include <cstdint>
+#include "timing_recovery.h"
 
 namespace gr {
 namespace radar_dsp {
@@ -16,14 +21,75 @@ namespace radar_dsp {
 class pulse_align_impl : public pulse_align
 {
 private:
-    std::vector<gr_complex> d_buf;
     int d_input_buffer_len, d_samps_per_sym;
     float d_samp_rate;
+    bool d_streaming;
+
+    // Matched filter, designed once and applied by FFT fast convolution
+    std::vector<float> d_taps;
+    int d_conv_len, d_fft_len;
+    std::unique_ptr<gr::fft::fft_complex_fwd> d_fwd;
+    std::unique_ptr<gr::fft::fft_complex_rev> d_rev;
+    std::vector<gr_complex> d_taps_fft;  // FFT of the zero-padded taps, scaled by 1/d_fft_len
+
+    // Symbol timing search, viewing the filtered vector as samps_per_sym interleaved phases
+    int d_max_syms_per_vec;               // Symbols produced by the phase with the most samples
+    std::vector<float> d_mag;             // |filtered sample|, d_conv_len long
+    std::vector<float> d_phase_energy;    // Summed magnitude of each phase, samps_per_sym long
+
+    // Streaming state, carried across vectors
+    std::vector<gr_complex> d_history;    // Last ntaps-1 input samples (overlap-save)
+    int d_next_sym;                       // Offset of the next symbol into the current vector's valid output
+    int d_reeval_interval, d_vecs_since_eval;
+    float d_ref_energy;                   // Average symbol magnitude at the last phase evaluation
+    bool d_phase_valid;
+
+    // Closed-loop alternative to the energy search (null when timing == ENERGY_SEARCH)
+    std::unique_ptr<timing_recovery> d_timing_recovery;
+
+    // Statistics, published on the "stats" port at most once per STATS_PERIOD
+    bool d_verbose;
+    uint64_t d_calls, d_vectors;
+    std::vector<uint64_t> d_shift_hist;   // How often each shift won (relative to the previous phase when streaming)
+    double d_margin_sum;                  // Sum of best / second-best shift energy ratios
+    uint64_t d_margin_count;
+    std::chrono::steady_clock::time_point d_last_report;
+
+    void record_shift(int shift, float best_avg_energy, float second_avg_energy);
+    void report_stats();
+
+    // "Full" convolution of one input vector with the matched filter, valid until the next call
+    const gr_complex* matched_filter(const gr_complex* vec);
+
+    // Continue the convolution from the previous vector; returns input_buffer_len valid outputs
+    const gr_complex* matched_filter_stream(const gr_complex* vec);
+
+    // Pick the decimation phase of `n` filtered samples with the highest average magnitude.
+    // The result is relative to sample `first`, i.e. phase p starts at sample (first + p) % sps.
+    int pick_phase(const gr_complex* buf, int n, int first, float& best_avg_energy, float& second_avg_energy);
+
+    // Per-vector alignment: each returns the number of symbols written to `out`
+    int align_vector(const gr_complex* vec, gr_complex* out);
+    int align_stream(const gr_complex* vec, gr_complex* out);
 
 public:
-    pulse_align_impl(int input_buffer_len, float samp_rate, int samps_per_sym);
+    pulse_align_impl(int input_buffer_len,
+                     float samp_rate,
+                     int samps_per_sym,
+                     bool streaming,
+                     int reeval_interval,
+                     timing_t timing,
+                     float loop_bw,
+                     bool verbose,
+                     float excess_bw);
     ~pulse_align_impl();
 
+    long calls() const override { return d_calls; }
+    long vectors_processed() const override { return d_vectors; }
+    double energy_margin() const override { return d_margin_count ? d_margin_sum / d_margin_count : 0.0; }
+
+    void setup_rpc() override;
+
     // Where all the action really happens
     void forecast(int noutput_items, gr_vector_int& ninput_items_required);
 
@@ -0,0 +1,112 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2023 Luke Jacobs.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "pulse_modulator.h"
+#include <gnuradio/filter/firdes.h>
+#include <volk/volk.h>
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace gr {
+namespace radar_dsp {
+
+pulse_modulator::pulse_modulator(modulation mod, int samps_per_sym, float excess_bw, int span_syms)
+    : d_sps(samps_per_sym),
+      d_bits_per_sym(mod == QPSK ? 2 : 1),
+      d_syms_per_byte(8 / d_bits_per_sym)
+{
+    if (samps_per_sym < 1 || span_syms < 1) {
+        throw std::invalid_argument("pulse_modulator: needs at least one sample per symbol and a pulse span");
+    }
+    if (excess_bw <= 0 || excess_bw > 1) {
+        throw std::invalid_argument("pulse_modulator: excess bandwidth must be in (0, 1]");
+    }
+
+    // Split the pulse into sps arms; arm p holds taps p, p+sps, ... reversed so that it lines up with the symbols
+    std::vector<float> taps =
+        filter::firdes::root_raised_cosine(1.0, samps_per_sym, 1.0, excess_bw, span_syms * samps_per_sym);
+    d_ntaps = taps.size();
+    d_taps_per_arm = (d_ntaps + d_sps - 1) / d_sps;
+    d_arms.assign(d_sps, std::vector<float>(d_taps_per_arm, 0.0));
+    for (int p = 0; p < d_sps; p++) {
+        for (int k = 0; k < d_taps_per_arm; k++) {
+            int tap = k * d_sps + p;
+            if (tap < d_ntaps)
+                d_arms[p][d_taps_per_arm - 1 - k] = taps[tap];
+        }
+    }
+
+    // Symbol of every bit group, then the symbols of every byte value
+    std::vector<gr_complex> points;
+    switch (mod) {
+    case OOK:
+        points = { gr_complex(0.0, 0.0), gr_complex(1.0, 0.0) };
+        break;
+    case BPSK:
+        points = { gr_complex(-1.0, 0.0), gr_complex(1.0, 0.0) };
+        break;
+    case QPSK:
+        for (int v = 0; v < 4; v++)
+            points.push_back(gr_complex(v & 1 ? M_SQRT1_2 : -M_SQRT1_2, v & 2 ? M_SQRT1_2 : -M_SQRT1_2));
+        break;
+    default:
+        throw std::invalid_argument("pulse_modulator: unknown modulation");
+    }
+    const int mask = (1 << d_bits_per_sym) - 1;
+    d_byte_syms.resize(256 * d_syms_per_byte);
+    for (int b = 0; b < 256; b++) {
+        for (int i = 0; i < d_syms_per_byte; i++)
+            d_byte_syms[b * d_syms_per_byte + i] = points[(b >> (i * d_bits_per_sym)) & mask];
+    }
+}
+
+void pulse_modulator::map(const uint8_t* bytes, size_t n, gr_complex* syms) const
+{
+    for (size_t i = 0; i < n; i++) {
+        const gr_complex* group = &d_byte_syms[bytes[i] * d_syms_per_byte];
+        std::copy(group, group + d_syms_per_byte, syms + i * d_syms_per_byte);
+    }
+}
+
+void pulse_modulator::shape(const gr_complex* syms, size_t n, gr_complex* out) const
+{
+    // Symbol period q sees syms[q - history() + j] through arm tap j; taps outside the burst see silence
+    const long total = n * d_sps + tail();
+    const long K = d_taps_per_arm;
+    for (long q = 0; q * d_sps < total; q++) {
+        long j0 = std::max(0L, K - 1 - q);
+        long j1 = std::min(K, (long)n + K - 1 - q);
+        const gr_complex* first = syms + (q - K + 1 + j0);
+        for (int p = 0; p < d_sps && q * d_sps + p < total; p++) {
+            gr_complex* dst = out + q * d_sps + p;
+            if (j1 > j0)
+                volk_32fc_32f_dot_prod_32fc(dst, first, &d_arms[p][j0], j1 - j0);
+            else
+                *dst = gr_complex(0.0, 0.0);
+        }
+    }
+}
+
+void pulse_modulator::shape_steady(const gr_complex* syms, size_t n, gr_complex* out) const
+{
+    for (size_t q = 0; q < n; q++) {
+        const gr_complex* window = syms + q - history();
+        for (int p = 0; p < d_sps; p++)
+            volk_32fc_32f_dot_prod_32fc(out + q * d_sps + p, window, &d_arms[p].front(), d_taps_per_arm);
+    }
+}
+
+void pulse_modulator::modulate(const uint8_t* bytes, size_t n, gr_complex* out) const
+{
+    std::vector<gr_complex> syms(n * d_syms_per_byte);
+    map(bytes, n, syms.data());
+    shape(syms.data(), syms.size(), out);
+}
+
+} // namespace radar_dsp
+} // namespace gr
@@ -0,0 +1,64 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2023 Luke Jacobs.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef INCLUDED_RADAR_DSP_PULSE_MODULATOR_H
+#define INCLUDED_RADAR_DSP_PULSE_MODULATOR_H
+
+#include <gnuradio/gr_complex.h>
+#include <cstdint>
+#include <vector>
+
+namespace gr {
+namespace radar_dsp {
+
+/*
+ * Table-driven linear modulator with root-raised-cosine pulse shaping
+ * - Bytes are mapped to symbols through a 256-entry table, least significant bits first (QPSK: bit 0 on I, bit 1
+ *   on Q). OOK sends 1 bits as 1+0j and 0 bits as silence, which is how usrp_tx_rx sends its count field.
+ * - Shaping is a polyphase interpolator: output phase p of a symbol period only uses the taps p, p+sps, p+2*sps, ...,
+ *   so each output sample costs taps/sps multiplications and none are spent on stuffed zeros.
+ */
+class pulse_modulator
+{
+public:
+    enum modulation { OOK, BPSK, QPSK };
+
+    // excess_bw: roll-off of the RRC pulse; span_syms: pulse length in symbols
+    pulse_modulator(modulation mod, int samps_per_sym, float excess_bw, int span_syms = 11);
+
+    int samps_per_sym() const { return d_sps; }
+    int symbols_per_byte() const { return d_syms_per_byte; }
+
+    // Symbols before the current one that shape_steady() reads
+    int history() const { return d_taps_per_arm - 1; }
+
+    // Samples a burst rings on after the last symbol period
+    int tail() const { return d_ntaps - 1; }
+
+    // Writes n * symbols_per_byte() symbols
+    void map(const uint8_t* bytes, size_t n, gr_complex* syms) const;
+
+    // One burst: n symbols surrounded by silence give n * samps_per_sym() + tail() samples
+    void shape(const gr_complex* syms, size_t n, gr_complex* out) const;
+
+    // Streaming: the n * samps_per_sym() samples of symbol periods 0..n-1, which also reads syms[-history()..-1]
+    void shape_steady(const gr_complex* syms, size_t n, gr_complex* out) const;
+
+    // map() followed by shape() for one burst of n bytes
+    void modulate(const uint8_t* bytes, size_t n, gr_complex* out) const;
+
+private:
+    int d_sps, d_bits_per_sym, d_syms_per_byte;
+    int d_ntaps, d_taps_per_arm;
+    std::vector<std::vector<float>> d_arms;  // Time-reversed polyphase arms, one per output phase
+    std::vector<gr_complex> d_byte_syms;     // Symbols of byte b at [b * d_syms_per_byte, (b+1) * d_syms_per_byte)
+};
+
+} // namespace radar_dsp
+} // namespace gr
+
+#endif /* INCLUDED_RADAR_DSP_PULSE_MODULATOR_H */
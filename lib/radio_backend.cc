@@ -0,0 +1,25 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2023 Luke Jacobs.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "radio_backend.h"
+#include "uhd_backend.h"
+#include "loopback_backend.h"
+#include <uhd/types/device_addr.hpp>
+
+namespace gr {
+namespace radar_dsp {
+
+radio_backend::uptr radio_backend::make(const std::string& args)
+{
+    uhd::device_addr_t device_args(args);
+    if (device_args.get("type") == "loopback")
+        return uptr(new loopback_backend(device_args));
+    return uptr(new uhd_backend(args));
+}
+
+} // namespace radar_dsp
+} // namespace gr
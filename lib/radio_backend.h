@@ -0,0 +1,86 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2023 Luke Jacobs.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef INCLUDED_RADAR_DSP_RADIO_BACKEND_H
+#define INCLUDED_RADAR_DSP_RADIO_BACKEND_H
+
+#include <gnuradio/gr_complex.h>
+#include <uhd/stream.hpp>
+#include <uhd/types/metadata.hpp>
+#include <uhd/types/sensors.hpp>
+#include <uhd/types/stream_cmd.hpp>
+#include <uhd/types/time_spec.hpp>
+#include <uhd/types/tune_request.hpp>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace gr {
+namespace radar_dsp {
+
+/*
+ * Radio Backend
+ * - The part of multi_usrp and its streamers that usrp_tx_rx relies on, so the block can run against a real device
+ *   (uhd_backend) or against other block instances in the same process (loopback_backend). UHD's metadata, time and
+ *   tune types are used as-is so the block logic is identical for both.
+ * - make() selects the implementation from the device args: "type=loopback,..." creates a loopback node, anything
+ *   else is handed to uhd::usrp::multi_usrp::make.
+ */
+class radio_backend
+{
+public:
+    typedef std::unique_ptr<radio_backend> uptr;
+
+    static uptr make(const std::string& args);
+
+    virtual ~radio_backend() {}
+
+    virtual std::string get_pp_string() = 0;
+
+    // Clocking and device time
+    virtual void set_clock_source(const std::string& source) = 0;
+    virtual void set_time_source(const std::string& source) = 0;
+    virtual void set_time_next_pps(const uhd::time_spec_t& time) = 0;
+    virtual uhd::time_spec_t get_time_now() = 0;
+    virtual uhd::time_spec_t get_time_last_pps() = 0;
+    virtual void set_command_time(const uhd::time_spec_t& time) = 0;
+    virtual void clear_command_time() = 0;
+
+    // Front end
+    virtual void set_rx_subdev_spec(const std::string& spec) = 0;
+    virtual void set_tx_gain(double gain, size_t chan) = 0;
+    virtual void set_rx_gain(double gain, size_t chan) = 0;
+    virtual void set_tx_rate(double rate, size_t chan) = 0;
+    virtual void set_rx_rate(double rate, size_t chan) = 0;
+    virtual double get_tx_rate(size_t chan) = 0;
+    virtual double get_rx_rate(size_t chan) = 0;
+    virtual void set_tx_freq(const uhd::tune_request_t& request, size_t chan) = 0;
+    virtual void set_rx_freq(const uhd::tune_request_t& request, size_t chan) = 0;
+
+    // Front-end sensors (e.g. "lo_locked"); only names listed by the *_names calls may be read
+    virtual std::vector<std::string> get_rx_sensor_names(size_t chan) = 0;
+    virtual std::vector<std::string> get_tx_sensor_names(size_t chan) = 0;
+    virtual uhd::sensor_value_t get_rx_sensor(const std::string& name, size_t chan) = 0;
+    virtual uhd::sensor_value_t get_tx_sensor(const std::string& name, size_t chan) = 0;
+
+    // Streaming (setup_streams must be called once before the calls below). TX uses a single channel and fc32; RX may
+    // stream several channels, and recv fills one buffer per RX channel with time-aligned samples in the RX args'
+    // host format (fc32 or sc16).
+    virtual void setup_streams(const uhd::stream_args_t& rx_args, const uhd::stream_args_t& tx_args) = 0;
+    virtual size_t get_max_num_samps() = 0;  // Samples in one RX packet
+    virtual size_t send(const gr_complex* buf, size_t n, const uhd::tx_metadata_t& md, double timeout) = 0;
+    virtual size_t recv(const std::vector<void*>& bufs, size_t n, uhd::rx_metadata_t& md, double timeout) = 0;
+    virtual void issue_stream_cmd(const uhd::stream_cmd_t& cmd) = 0;
+
+    // TX burst acknowledgements and errors; returns false when nothing arrived within the timeout
+    virtual bool recv_async_msg(uhd::async_metadata_t& md, double timeout) = 0;
+};
+
+} // namespace radar_dsp
+} // namespace gr
+
+#endif /* INCLUDED_RADAR_DSP_RADIO_BACKEND_H */
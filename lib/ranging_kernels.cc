@@ -0,0 +1,72 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2023 Luke Jacobs.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "ranging_kernels.h"
+#include <gnuradio/math.h>
+#include <cmath>
+
+namespace gr {
+namespace radar_dsp {
+
+static const double C = 299792458;
+
+float estimate_cfo(const gr_complex* rx_ts, int training_seq_len, float samp_rate)
+{
+    // The second half is the first one rotated by the CFO over half a sequence
+    const int half_len = training_seq_len / 2;
+    gr_complex corr(0.0, 0.0);
+    for (int i = 0; i < half_len; i++)
+        corr += std::conj(rx_ts[i]) * rx_ts[half_len + i];
+    return -std::arg(corr) * samp_rate / (2 * GR_M_PI * half_len);
+}
+
+gr_complex estimate_channel(const gr_complex* rx_ts, const gr_complex* ts, int training_seq_len, float cfo, float samp_rate)
+{
+    // The CFO estimate needs to have the correct sign or else this will not work
+    const double step = 2.0 * GR_M_PI * cfo / samp_rate;
+    gr_complex corr(0.0, 0.0);
+    for (int i = 0; i < training_seq_len; i++)
+        corr += std::conj(rx_ts[i] * std::polar(1.0f, (float)std::remainder(step * i, 2 * GR_M_PI))) * ts[i];
+    return corr / std::abs(corr);
+}
+
+void measure_tone_phases(const gr_complex* samples, int n, const float* tone_frequencies, int n_tones, float cfo,
+                         float samp_rate, float* phases)
+{
+    // Correlate against each tone, advancing its phasor by recurrence (in double, so n steps add no visible error)
+    for (int tone_i = 0; tone_i < n_tones; tone_i++) {
+        const gr_complexd step = std::polar(1.0, -2.0 * GR_M_PI * (tone_frequencies[tone_i] - cfo) / samp_rate);
+        gr_complexd tone(1.0, 0.0), corr(0.0, 0.0);
+        for (int i = 0; i < n; i++) {
+            corr += tone * gr_complexd(samples[i]);
+            tone *= step;
+        }
+        phases[tone_i] = std::arg(corr);
+    }
+}
+
+float lls_distance(float f_c, const float* f_i, int n_tones, float cfo, const float* phases)
+{
+    // Least-squares slope of phase over x, the delay tau; computed on centred values in double since x is ~1e10
+    double x_mean = 0.0, y_mean = 0.0;
+    for (int i = 0; i < n_tones; i++) {
+        x_mean += -2 * GR_M_PI * (2.0 * f_c + cfo + f_i[i]);
+        y_mean += phases[i];
+    }
+    x_mean /= n_tones;
+    y_mean /= n_tones;
+    double sxy = 0.0, sxx = 0.0;
+    for (int i = 0; i < n_tones; i++) {
+        double dx = -2 * GR_M_PI * (2.0 * f_c + cfo + f_i[i]) - x_mean;
+        sxy += dx * (phases[i] - y_mean);
+        sxx += dx * dx;
+    }
+    return sxx > 0 ? sxy / sxx * C : 0.0;
+}
+
+} // namespace radar_dsp
+} // namespace gr
@@ -0,0 +1,39 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2023 Luke Jacobs.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef INCLUDED_RADAR_DSP_RANGING_KERNELS_H
+#define INCLUDED_RADAR_DSP_RANGING_KERNELS_H
+
+#include <gnuradio/gr_complex.h>
+
+namespace gr {
+namespace radar_dsp {
+
+/*
+ * Ranging Kernels
+ * - The per-packet math of cfo_estimator, channel_estimator, phase_measurement and lls, shared with the fused
+ *   ranging_receiver. Each kernel reads its inputs in place and allocates nothing, so a packet can go through all of
+ *   them while it is still in cache.
+ */
+
+// CFO (Hz) to add to the TX carrier to get the RX carrier, from a training sequence of two identical halves
+float estimate_cfo(const gr_complex* rx_ts, int training_seq_len, float samp_rate);
+
+// Unit rotation that undoes the channel phase, after removing `cfo` from the received training sequence
+gr_complex estimate_channel(const gr_complex* rx_ts, const gr_complex* ts, int training_seq_len, float cfo, float samp_rate);
+
+// Phase of each tone (shifted by -cfo) at the first of the n samples
+void measure_tone_phases(const gr_complex* samples, int n, const float* tone_frequencies, int n_tones, float cfo,
+                         float samp_rate, float* phases);
+
+// Distance (m) from the slope of a line fit of the tone phases over -2*pi*(2*f_c + cfo + f_i)
+float lls_distance(float f_c, const float* f_i, int n_tones, float cfo, const float* phases);
+
+} // namespace radar_dsp
+} // namespace gr
+
+#endif /* INCLUDED_RADAR_DSP_RANGING_KERNELS_H */
@@ -0,0 +1,78 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2023 Luke Jacobs.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include <gnuradio/io_signature.h>
+#include "ranging_receiver_impl.h"
+#include "ranging_kernels.h"
+#include <stdexcept>
+
+namespace gr {
+  namespace radar_dsp {
+
+    ranging_receiver::sptr ranging_receiver::make(int training_seq_len, int packet_len, float samp_rate, const std::vector<gr_complex>& ts_buf, float f_c, const std::vector<float>& tone_frequencies)
+    {
+      return gnuradio::make_block_sptr<ranging_receiver_impl>(training_seq_len, packet_len, samp_rate, ts_buf, f_c, tone_frequencies);
+    }
+
+    /*
+     * The private constructor
+     */
+    ranging_receiver_impl::ranging_receiver_impl(int training_seq_len, int packet_len, float samp_rate, const std::vector<gr_complex>& ts_buf, float f_c, const std::vector<float>& tone_frequencies)
+      : gr::sync_block("ranging_receiver",
+                       gr::io_signature::make2(2 /* min inputs */, 2 /* max inputs */, sizeof(gr_complex)*packet_len, sizeof(gr_complex)*training_seq_len),
+                       gr::io_signature::makev(1 /* min outputs */, 4 /*max outputs */,
+                                               { sizeof(float), sizeof(float), sizeof(gr_complex), (int)(sizeof(float)*tone_frequencies.size()) })),
+        d_training_seq_len(training_seq_len),
+        d_packet_len(packet_len),
+        d_samp_rate(samp_rate),
+        d_ts_buf(ts_buf),
+        d_f_c(f_c),
+        d_tone_frequencies(tone_frequencies),
+        d_phases(tone_frequencies.size())
+    {
+      if (tone_frequencies.size() < 2)
+        throw std::invalid_argument("ranging_receiver: the line fit needs at least two tones");
+      if ((int)ts_buf.size() != training_seq_len)
+        throw std::invalid_argument("ranging_receiver: ts_buf must hold training_seq_len symbols");
+    }
+
+    /*
+     * Our virtual destructor.
+     */
+    ranging_receiver_impl::~ranging_receiver_impl() {}
+
+    int
+    ranging_receiver_impl::work(int noutput_items, gr_vector_const_void_star &input_items, gr_vector_void_star &output_items) {
+      auto packet_in = static_cast<const gr_complex *>(input_items[0]);
+      auto rx_ts_in = static_cast<const gr_complex *>(input_items[1]);
+      auto out_dist = static_cast<float *>(output_items[0]);
+      auto out_cfo = output_items.size() > 1 ? static_cast<float *>(output_items[1]) : nullptr;
+      auto out_chan = output_items.size() > 2 ? static_cast<gr_complex *>(output_items[2]) : nullptr;
+      auto out_phases = output_items.size() > 3 ? static_cast<float *>(output_items[3]) : nullptr;
+      const int n_tones = d_tone_frequencies.size();
+
+      for (int vec_i = 0; vec_i < noutput_items; vec_i++) {
+        const gr_complex* rx_ts = rx_ts_in + vec_i * d_training_seq_len;
+        float* phases = out_phases ? out_phases + vec_i * n_tones : d_phases.data();
+
+        float cfo = estimate_cfo(rx_ts, d_training_seq_len, d_samp_rate);
+        measure_tone_phases(packet_in + vec_i * d_packet_len, d_packet_len, d_tone_frequencies.data(), n_tones, cfo,
+                            d_samp_rate, phases);
+        out_dist[vec_i] = lls_distance(d_f_c, d_tone_frequencies.data(), n_tones, cfo, phases);
+
+        if (out_cfo)
+          out_cfo[vec_i] = cfo;
+        if (out_chan)
+          out_chan[vec_i] = estimate_channel(rx_ts, d_ts_buf.data(), d_training_seq_len, cfo, d_samp_rate);
+      }
+
+      // Tell runtime system how many output items we produced.
+      return noutput_items;
+    }
+
+  } /* namespace radar_dsp */
+} /* namespace gr */
@@ -0,0 +1,38 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2023 Luke Jacobs.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef INCLUDED_RADAR_DSP_RANGING_RECEIVER_IMPL_H
+#define INCLUDED_RADAR_DSP_RANGING_RECEIVER_IMPL_H
+
+#include <gnuradio/radar_dsp/ranging_receiver.h>
+
+namespace gr {
+  namespace radar_dsp {
+
+    class ranging_receiver_impl : public ranging_receiver
+    {
+     private:
+      int d_training_seq_len;
+      int d_packet_len;
+      float d_samp_rate;
+      std::vector<gr_complex> d_ts_buf;
+      float d_f_c;
+      std::vector<float> d_tone_frequencies;
+      std::vector<float> d_phases;  // Tone phases of one packet when output 3 is not connected
+
+     public:
+      ranging_receiver_impl(int training_seq_len, int packet_len, float samp_rate, const std::vector<gr_complex>& ts_buf, float f_c, const std::vector<float>& tone_frequencies);
+      ~ranging_receiver_impl();
+
+      // Where all the action really happens
+      int work(int noutput_items, gr_vector_const_void_star &input_items, gr_vector_void_star &output_items);
+    };
+
+  } // namespace radar_dsp
+} // namespace gr
+
+#endif /* INCLUDED_RADAR_DSP_RANGING_RECEIVER_IMPL_H */
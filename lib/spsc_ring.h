@@ -0,0 +1,80 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2023 Luke Jacobs.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef INCLUDED_RADAR_DSP_SPSC_RING_H
+#define INCLUDED_RADAR_DSP_SPSC_RING_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+namespace gr {
+namespace radar_dsp {
+
+/*
+ * Lock-free Single-Producer/Single-Consumer Ring Buffer
+ * - One thread writes, one other thread reads; no locks are taken on either side.
+ * - The producer fills the ring in place (write_ptr/commit_write) so a device can receive straight into it; the
+ *   consumer copies out with read().
+ * - The capacity is rounded up to a power of two so positions wrap with a mask.
+ */
+template <typename T>
+class spsc_ring
+{
+private:
+    std::vector<T> d_buf;
+    size_t d_mask;
+    alignas(64) std::atomic<size_t> d_head;  // Total items written (owned by the producer)
+    alignas(64) std::atomic<size_t> d_tail;  // Total items read (owned by the consumer)
+
+public:
+    spsc_ring(size_t min_capacity) : d_head(0), d_tail(0)
+    {
+        size_t capacity = 1;
+        while (capacity < min_capacity)
+            capacity <<= 1;
+        d_buf.resize(capacity);
+        d_mask = capacity - 1;
+    }
+
+    size_t capacity() const { return d_buf.size(); }
+
+    // Items written since construction, i.e. the stream position of the next write
+    size_t total_written() const { return d_head.load(std::memory_order_relaxed); }
+
+    size_t size() const { return d_head.load(std::memory_order_acquire) - d_tail.load(std::memory_order_acquire); }
+
+    // Producer: contiguous free space starting at the returned pointer (0 when the ring is full)
+    T* write_ptr(size_t& contiguous)
+    {
+        size_t head = d_head.load(std::memory_order_relaxed);
+        size_t free = capacity() - (head - d_tail.load(std::memory_order_acquire));
+        contiguous = std::min(free, capacity() - (head & d_mask));
+        return &d_buf[head & d_mask];
+    }
+
+    // Producer: publish n items written through write_ptr()
+    void commit_write(size_t n) { d_head.store(d_head.load(std::memory_order_relaxed) + n, std::memory_order_release); }
+
+    // Consumer: copy up to n items into out, returns the number copied
+    size_t read(T* out, size_t n)
+    {
+        size_t tail = d_tail.load(std::memory_order_relaxed);
+        n = std::min(n, d_head.load(std::memory_order_acquire) - tail);
+        size_t first = std::min(n, capacity() - (tail & d_mask));
+        std::copy(d_buf.begin() + (tail & d_mask), d_buf.begin() + (tail & d_mask) + first, out);
+        std::copy(d_buf.begin(), d_buf.begin() + (n - first), out + first);
+        d_tail.store(tail + n, std::memory_order_release);
+        return n;
+    }
+};
+
+} // namespace radar_dsp
+} // namespace gr
+
+#endif /* INCLUDED_RADAR_DSP_SPSC_RING_H */
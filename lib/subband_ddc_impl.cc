@@ -0,0 +1,88 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2023 Luke Jacobs.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "subband_ddc_impl.h"
+#include <gnuradio/io_signature.h>
+#include <gnuradio/filter/firdes.h>
+#include <gnuradio/math.h>
+#include <stdexcept>
+
+namespace gr {
+namespace radar_dsp {
+
+subband_ddc::sptr subband_ddc::make(float sampling_rate, const std::vector<double>& offsets, int decimation, float bandwidth)
+{
+    return gnuradio::make_block_sptr<subband_ddc_impl>(sampling_rate, offsets, decimation, bandwidth);
+}
+
+/*
+ * The private constructor
+ * - Each band is a frequency-translating FIR: the prototype low-pass h[k] becomes the band-pass h[k]*e^{jwk}, which
+ *   is only evaluated at every decimation-th input, and the output is then rotated by e^{-jwn} (n being the index of
+ *   the newest input). The result equals mixing the band to DC with an NCO that starts at the first input sample and
+ *   low-pass filtering it.
+ */
+subband_ddc_impl::subband_ddc_impl(float sampling_rate, const std::vector<double>& offsets, int decimation, float bandwidth)
+    : gr::sync_decimator("subband_ddc",
+                         gr::io_signature::make(1 /* min inputs */, 1 /* max inputs */, sizeof(gr_complex)),
+                         gr::io_signature::make(offsets.size() /* min outputs */, offsets.size() /*max outputs */, sizeof(gr_complex)),
+                         decimation)
+{
+  if (offsets.empty() || decimation < 1)
+    throw std::invalid_argument("subband_ddc: need at least one band and a positive decimation");
+  const double out_rate = sampling_rate / decimation;
+  if (bandwidth <= 0 || bandwidth >= out_rate)
+    throw std::invalid_argument("subband_ddc: bandwidth must be positive and below the decimated sample rate");
+  for (double offset : offsets) {
+    if (std::abs(offset) + bandwidth / 2 > sampling_rate / 2)
+      throw std::invalid_argument("subband_ddc: every band must lie within the captured bandwidth");
+  }
+
+  // Passband edge at bandwidth/2, stopband from out_rate - bandwidth/2 on, so aliases stay outside the passband
+  std::vector<float> proto = filter::firdes::low_pass(1.0, sampling_rate, out_rate / 2, out_rate - bandwidth);
+  set_history(proto.size());
+
+  for (double offset : offsets) {
+    double w = 2 * GR_M_PI * offset / sampling_rate;
+    std::vector<gr_complex> taps(proto.size());
+    for (size_t k = 0; k < proto.size(); k++)
+      taps[k] = proto[k] * std::polar(1.0f, (float)(w * k));
+    d_filters.emplace_back(new filter::kernel::fir_filter_ccc(taps));
+    d_phasors.push_back(gr_complex(1.0, 0.0));  // The first output's newest input is the first sample (after history)
+    d_steps.push_back(std::polar(1.0f, (float)std::remainder(-w * decimation, 2 * GR_M_PI)));
+  }
+}
+
+/*
+ * Our virtual destructor.
+ */
+subband_ddc_impl::~subband_ddc_impl() {}
+
+int subband_ddc_impl::work(int noutput_items,
+                           gr_vector_const_void_star& input_items,
+                           gr_vector_void_star& output_items)
+{
+  auto in = static_cast<const gr_complex *>(input_items[0]);
+
+  for (size_t band_i = 0; band_i < d_filters.size(); band_i++) {
+    auto out = static_cast<gr_complex *>(output_items[band_i]);
+    d_filters[band_i]->filterNdec(out, in, noutput_items, decimation());
+
+    gr_complex phasor = d_phasors[band_i];
+    for (int i = 0; i < noutput_items; i++) {
+      out[i] *= phasor;
+      phasor *= d_steps[band_i];
+    }
+    d_phasors[band_i] = phasor / std::abs(phasor);  // Keep rounding errors from growing the amplitude
+  }
+
+  // Tell runtime system how many output items we produced.
+  return noutput_items;
+}
+
+} /* namespace radar_dsp */
+} /* namespace gr */
@@ -0,0 +1,37 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2023 Luke Jacobs.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef INCLUDED_RADAR_DSP_SUBBAND_DDC_IMPL_H
+#define INCLUDED_RADAR_DSP_SUBBAND_DDC_IMPL_H
+
+#include <gnuradio/radar_dsp/subband_ddc.h>
+#include <gnuradio/filter/fir_filter.h>
+#include <memory>
+
+namespace gr {
+  namespace radar_dsp {
+
+    class subband_ddc_impl : public subband_ddc
+    {
+     private:
+      std::vector<std::unique_ptr<filter::kernel::fir_filter_ccc>> d_filters;  // Band-pass taps, one per band
+      std::vector<gr_complex> d_phasors;  // Down-conversion phase of each band at the next output
+      std::vector<gr_complex> d_steps;    // Phase advance of each band per output sample
+
+     public:
+      subband_ddc_impl(float sampling_rate, const std::vector<double>& offsets, int decimation, float bandwidth);
+      ~subband_ddc_impl();
+
+      int work(int noutput_items,
+               gr_vector_const_void_star &input_items,
+               gr_vector_void_star &output_items);
+    };
+
+  } // namespace radar_dsp
+} // namespace gr
+
+#endif /* INCLUDED_RADAR_DSP_SUBBAND_DDC_IMPL_H */
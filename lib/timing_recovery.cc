@@ -0,0 +1,129 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2023 Luke Jacobs.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "timing_recovery.h"
+#include <volk/volk.h>
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace gr {
+namespace radar_dsp {
+
+timing_recovery::timing_recovery(ted_type ted,
+                                 float samps_per_sym,
+                                 const std::vector<float>& prototype_taps,
+                                 int nfilts,
+                                 float loop_bw,
+                                 float damping,
+                                 float max_deviation)
+    : d_ted(ted),
+      d_nfilts(nfilts),
+      d_nominal_period(samps_per_sym),
+      d_period(samps_per_sym),
+      d_max_deviation(max_deviation),
+      d_buf_len(0),
+      d_prev_sym(0.0, 0.0),
+      d_prev_decision(0.0, 0.0)
+{
+    if (nfilts < 1 || samps_per_sym < 2) {
+        throw std::invalid_argument("timing_recovery: needs nfilts >= 1 and at least 2 samples per symbol");
+    }
+
+    // Split the prototype into nfilts arms; arm a delays the matched filter output by a/nfilts of a sample
+    d_taps_per_arm = (prototype_taps.size() + nfilts - 1) / nfilts;
+    d_arms.assign(nfilts, std::vector<float>(d_taps_per_arm, 0.0));
+    for (int a = 0; a < nfilts; a++) {
+        for (int m = 0; m < d_taps_per_arm; m++) {
+            size_t tap = m * nfilts + a;
+            if (tap < prototype_taps.size())
+                d_arms[a][d_taps_per_arm - 1 - m] = prototype_taps[tap];
+        }
+    }
+
+    // Second-order loop gains for the normalized bandwidth, scaled from symbols to samples
+    float theta = loop_bw / (damping + 1.0 / (4.0 * damping));
+    float denom = 1.0 + 2.0 * damping * theta + theta * theta;
+    d_alpha = 4.0 * damping * theta / denom * d_nominal_period;
+    d_beta = 4.0 * theta * theta / denom * d_nominal_period;
+
+    // The first strobe needs a full arm of history behind its half-symbol midpoint
+    d_strobe = d_taps_per_arm + d_nominal_period / 2.0;
+}
+
+int timing_recovery::max_symbols(int n) const
+{
+    float min_step = std::max((float)1.0, d_nominal_period * (1 - d_max_deviation) - d_alpha);
+    return (int)std::ceil(n / min_step) + 2;
+}
+
+gr_complex timing_recovery::slice(gr_complex sym)
+{
+    return gr_complex(sym.real() >= 0 ? 1.0 : -1.0, sym.imag() >= 0 ? 1.0 : -1.0);
+}
+
+gr_complex timing_recovery::interpolate(double t) const
+{
+    int idx = (int)std::floor(t);
+    int arm = (int)std::lround((t - idx) * d_nfilts);
+    if (arm == d_nfilts) {
+        arm = 0;
+        idx++;
+    }
+
+    gr_complex result;
+    volk_32fc_32f_dot_prod_32fc(&result, &d_buf[idx - d_taps_per_arm + 1], d_arms[arm].data(), d_taps_per_arm);
+    return result;
+}
+
+int timing_recovery::process(const gr_complex* in, int n, gr_complex* out, int max_out)
+{
+    // Only grows the first time a caller hands over a larger block
+    if (d_buf_len + n > (int)d_buf.size())
+        d_buf.resize(d_buf_len + n);
+    std::copy(in, in + n, d_buf.begin() + d_buf_len);
+    d_buf_len += n;
+
+    int n_out = 0;
+    while (n_out < max_out && (int)std::floor(d_strobe) + 1 < d_buf_len) {
+        gr_complex sym = interpolate(d_strobe);
+
+        // Both detectors are positive when the strobe is early, so the loop advances it by +error
+        float error;
+        if (d_ted == GARDNER) {
+            gr_complex mid = interpolate(d_strobe - d_period / 2.0);
+            error = std::real((d_prev_sym - sym) * std::conj(mid));
+        } else {
+            gr_complex decision = slice(sym);
+            error = std::real(std::conj(d_prev_decision) * sym - std::conj(decision) * d_prev_sym);
+            d_prev_decision = decision;
+        }
+        error = std::clamp(error, (float)-1.0, (float)1.0);
+        d_prev_sym = sym;
+        out[n_out++] = sym;
+
+        // PI loop: the integral term follows the sample clock offset, the proportional term nudges this strobe
+        d_period = std::clamp(d_period + d_beta * error,
+                              d_nominal_period * (1 - d_max_deviation),
+                              d_nominal_period * (1 + d_max_deviation));
+        d_strobe += d_period + d_alpha * error;
+    }
+
+    // Keep only the samples that the next strobe (and its midpoint) can still reach
+    int keep_from = (int)std::floor(d_strobe - d_period / 2.0) - d_taps_per_arm - 1;
+    keep_from = std::clamp(keep_from, 0, d_buf_len);
+    if (keep_from > 0) {
+        std::copy(d_buf.begin() + keep_from, d_buf.begin() + d_buf_len, d_buf.begin());
+        d_buf_len -= keep_from;
+        d_strobe -= keep_from;
+    }
+
+    return n_out;
+}
+
+} /* namespace radar_dsp */
+} /* namespace gr */
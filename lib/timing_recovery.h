@@ -0,0 +1,68 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2023 Luke Jacobs.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef INCLUDED_RADAR_DSP_TIMING_RECOVERY_H
+#define INCLUDED_RADAR_DSP_TIMING_RECOVERY_H
+
+#include <gnuradio/gr_complex.h>
+#include <vector>
+
+namespace gr {
+namespace radar_dsp {
+
+/*
+ * Closed-loop symbol timing recovery
+ * - Interpolates the input at the current symbol strobe with a polyphase bank of matched filters (one arm per
+ *   1/nfilts of a sample), feeds a Gardner or Mueller-Muller timing error into a PI loop, and advances the strobe
+ *   by the tracked symbol period. Each output symbol costs one (Gardner: two) taps_per_arm dot products.
+ * - The engine keeps its own history, so consecutive calls to process() form one continuous stream.
+ */
+class timing_recovery
+{
+public:
+    enum ted_type { GARDNER, MUELLER_MULLER };
+
+    // prototype_taps: matched filter designed at nfilts*samp_rate with a gain of nfilts
+    // loop_bw: loop bandwidth normalized to the symbol rate; max_deviation: largest allowed clock offset (fraction of sps)
+    timing_recovery(ted_type ted,
+                    float samps_per_sym,
+                    const std::vector<float>& prototype_taps,
+                    int nfilts,
+                    float loop_bw,
+                    float damping = 0.707,
+                    float max_deviation = 0.01);
+
+    // Append n samples and write every symbol whose strobe now falls inside the available input.
+    // Returns the number of symbols written; max_out must be at least max_symbols(n).
+    int process(const gr_complex* in, int n, gr_complex* out, int max_out);
+
+    // Upper bound on the symbols produced from n new samples
+    int max_symbols(int n) const;
+
+    // Current estimate of the symbol period in samples
+    float period() const { return d_period; }
+
+private:
+    ted_type d_ted;
+    int d_nfilts, d_taps_per_arm;
+    std::vector<std::vector<float>> d_arms;  // Time-reversed polyphase arms for contiguous dot products
+    float d_nominal_period, d_period, d_max_deviation;
+    float d_alpha, d_beta;                   // Proportional and integral loop gains
+
+    std::vector<gr_complex> d_buf;           // History followed by the newest input
+    int d_buf_len;
+    double d_strobe;                         // Position of the next symbol in d_buf, in samples
+    gr_complex d_prev_sym, d_prev_decision;
+
+    gr_complex interpolate(double t) const;
+    static gr_complex slice(gr_complex sym);
+};
+
+} // namespace radar_dsp
+} // namespace gr
+
+#endif /* INCLUDED_RADAR_DSP_TIMING_RECOVERY_H */
@@ -0,0 +1,94 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2023 Luke Jacobs.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "uhd_backend.h"
+#include <iostream>
+
+namespace gr {
+namespace radar_dsp {
+
+uhd_backend::uhd_backend(const std::string& args)
+{
+    std::cout << "Searching for USRP devices matching \"" << args << "\"..." << std::endl;
+    d_usrp = uhd::usrp::multi_usrp::make(uhd::device_addr_t(args));
+}
+
+std::string uhd_backend::get_pp_string() { return d_usrp->get_pp_string(); }
+
+void uhd_backend::set_clock_source(const std::string& source) { d_usrp->set_clock_source(source); }
+
+void uhd_backend::set_time_source(const std::string& source) { d_usrp->set_time_source(source); }
+
+void uhd_backend::set_time_next_pps(const uhd::time_spec_t& time) { d_usrp->set_time_next_pps(time); }
+
+uhd::time_spec_t uhd_backend::get_time_now() { return d_usrp->get_time_now(); }
+
+uhd::time_spec_t uhd_backend::get_time_last_pps() { return d_usrp->get_time_last_pps(); }
+
+void uhd_backend::set_command_time(const uhd::time_spec_t& time) { d_usrp->set_command_time(time); }
+
+void uhd_backend::clear_command_time() { d_usrp->clear_command_time(); }
+
+void uhd_backend::set_rx_subdev_spec(const std::string& spec) { d_usrp->set_rx_subdev_spec(spec); }
+
+void uhd_backend::set_tx_gain(double gain, size_t chan) { d_usrp->set_tx_gain(gain, chan); }
+
+void uhd_backend::set_rx_gain(double gain, size_t chan) { d_usrp->set_rx_gain(gain, chan); }
+
+void uhd_backend::set_tx_rate(double rate, size_t chan) { d_usrp->set_tx_rate(rate, chan); }
+
+void uhd_backend::set_rx_rate(double rate, size_t chan) { d_usrp->set_rx_rate(rate, chan); }
+
+double uhd_backend::get_tx_rate(size_t chan) { return d_usrp->get_tx_rate(chan); }
+
+double uhd_backend::get_rx_rate(size_t chan) { return d_usrp->get_rx_rate(chan); }
+
+void uhd_backend::set_tx_freq(const uhd::tune_request_t& request, size_t chan) { d_usrp->set_tx_freq(request, chan); }
+
+void uhd_backend::set_rx_freq(const uhd::tune_request_t& request, size_t chan) { d_usrp->set_rx_freq(request, chan); }
+
+std::vector<std::string> uhd_backend::get_rx_sensor_names(size_t chan) { return d_usrp->get_rx_sensor_names(chan); }
+
+std::vector<std::string> uhd_backend::get_tx_sensor_names(size_t chan) { return d_usrp->get_tx_sensor_names(chan); }
+
+uhd::sensor_value_t uhd_backend::get_rx_sensor(const std::string& name, size_t chan)
+{
+    return d_usrp->get_rx_sensor(name, chan);
+}
+
+uhd::sensor_value_t uhd_backend::get_tx_sensor(const std::string& name, size_t chan)
+{
+    return d_usrp->get_tx_sensor(name, chan);
+}
+
+void uhd_backend::setup_streams(const uhd::stream_args_t& rx_args, const uhd::stream_args_t& tx_args)
+{
+    d_tx_stream = d_usrp->get_tx_stream(tx_args);
+    d_rx_stream = d_usrp->get_rx_stream(rx_args);
+}
+
+size_t uhd_backend::get_max_num_samps() { return d_rx_stream->get_max_num_samps(); }
+
+size_t uhd_backend::send(const gr_complex* buf, size_t n, const uhd::tx_metadata_t& md, double timeout)
+{
+    return d_tx_stream->send(buf, n, md, timeout);
+}
+
+size_t uhd_backend::recv(const std::vector<void*>& bufs, size_t n, uhd::rx_metadata_t& md, double timeout)
+{
+    return d_rx_stream->recv(bufs, n, md, timeout);
+}
+
+void uhd_backend::issue_stream_cmd(const uhd::stream_cmd_t& cmd) { d_rx_stream->issue_stream_cmd(cmd); }
+
+bool uhd_backend::recv_async_msg(uhd::async_metadata_t& md, double timeout)
+{
+    return d_tx_stream->recv_async_msg(md, timeout);
+}
+
+} // namespace radar_dsp
+} // namespace gr
@@ -0,0 +1,66 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2023 Luke Jacobs.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef INCLUDED_RADAR_DSP_UHD_BACKEND_H
+#define INCLUDED_RADAR_DSP_UHD_BACKEND_H
+
+#include "radio_backend.h"
+#include <uhd/usrp/multi_usrp.hpp>
+
+namespace gr {
+namespace radar_dsp {
+
+/*
+ * Radio backend for a physical USRP (thin forwarding layer over multi_usrp)
+ */
+class uhd_backend : public radio_backend
+{
+private:
+    uhd::usrp::multi_usrp::sptr d_usrp;
+    uhd::rx_streamer::sptr d_rx_stream;
+    uhd::tx_streamer::sptr d_tx_stream;
+
+public:
+    uhd_backend(const std::string& args);
+
+    std::string get_pp_string() override;
+
+    void set_clock_source(const std::string& source) override;
+    void set_time_source(const std::string& source) override;
+    void set_time_next_pps(const uhd::time_spec_t& time) override;
+    uhd::time_spec_t get_time_now() override;
+    uhd::time_spec_t get_time_last_pps() override;
+    void set_command_time(const uhd::time_spec_t& time) override;
+    void clear_command_time() override;
+
+    void set_rx_subdev_spec(const std::string& spec) override;
+    void set_tx_gain(double gain, size_t chan) override;
+    void set_rx_gain(double gain, size_t chan) override;
+    void set_tx_rate(double rate, size_t chan) override;
+    void set_rx_rate(double rate, size_t chan) override;
+    double get_tx_rate(size_t chan) override;
+    double get_rx_rate(size_t chan) override;
+    void set_tx_freq(const uhd::tune_request_t& request, size_t chan) override;
+    void set_rx_freq(const uhd::tune_request_t& request, size_t chan) override;
+
+    std::vector<std::string> get_rx_sensor_names(size_t chan) override;
+    std::vector<std::string> get_tx_sensor_names(size_t chan) override;
+    uhd::sensor_value_t get_rx_sensor(const std::string& name, size_t chan) override;
+    uhd::sensor_value_t get_tx_sensor(const std::string& name, size_t chan) override;
+
+    void setup_streams(const uhd::stream_args_t& rx_args, const uhd::stream_args_t& tx_args) override;
+    size_t get_max_num_samps() override;
+    size_t send(const gr_complex* buf, size_t n, const uhd::tx_metadata_t& md, double timeout) override;
+    size_t recv(const std::vector<void*>& bufs, size_t n, uhd::rx_metadata_t& md, double timeout) override;
+    void issue_stream_cmd(const uhd::stream_cmd_t& cmd) override;
+    bool recv_async_msg(uhd::async_metadata_t& md, double timeout) override;
+};
+
+} // namespace radar_dsp
+} // namespace gr
+
+#endif /* INCLUDED_RADAR_DSP_UHD_BACKEND_H */
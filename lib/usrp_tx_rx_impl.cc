@@ -8,100 +8,222 @@
 #include "usrp_tx_rx_impl.h"
 #include <gnuradio/io_signature.h>
 #include <algorithm>
-#include <gnuradio/filter/firdes.h>
-#include <armadillo>
-#include <bitset>
+#include <cmath>
+#include <cstring>
+#include <gnuradio/thread/thread.h>
+
+#ifdef GR_CTRLPORT
+#include <gnuradio/rpcregisterhelpers.h>
+#endif
 
 namespace gr {
 namespace radar_dsp {
 
-/*
- * Matched Filter Convolution
- */
-std::vector<gr_complex> rrc_filter(std::vector<gr_complex>& buf, float samp_rate, int samps_per_sym, int num_taps) {
-  std::vector<float> taps = filter::firdes::root_raised_cosine(1.0, samp_rate, samp_rate / samps_per_sym, 0.35, num_taps);
-  arma::cx_fvec in_vec(buf);
-  std::vector<gr_complex> ctaps(taps.size());
-  for (int i = 0; i < taps.size(); i++)
-    ctaps[i] = std::complex<float>(taps[i], 0.0);
-  arma::cx_fvec taps_vec(ctaps);
-  arma::cx_fvec out = arma::conv(in_vec, taps_vec, "full");  // With "full", the output size is larger than either input vector
-  return std::vector<gr_complex>(out.begin(), out.end());
-}
+// Length of the RX thread's ring buffer
+static const float RX_RING_SECONDS = 0.25;
 
-/*
- * Upsampling
- */
-std::vector<gr_complex> upsample(const std::vector<gr_complex> &in_buf, int upsampling_rate) {
-  assert(upsampling_rate > 0);
-  std::vector<gr_complex> out(in_buf.size() * upsampling_rate, gr_complex(0.0, 0.0));
-  for (int i = 0; i < in_buf.size(); i++) {
-    out[i*upsampling_rate] = in_buf[i];
+// recv() timeout in the RX thread, which bounds how long stopping the thread takes
+static const double RX_THREAD_TIMEOUT = 0.1;
+
+// How far ahead of a round its packets, stream command and tune are issued (covers host-to-device latency)
+static const double SCHEDULE_LEAD_SECONDS = 0.05;
+
+// LO settling time after a timed retune before a round starts transmitting or receiving
+static const double TUNE_SETTLE_SECONDS = 0.01;
+
+// Carrier step applied at the start of every exchange (pair of rounds) when no hop plan is set
+static const double HOP_STEP_HZ = 100e6;
+
+// Longest single wait inside general_work, so the block stays responsive to flowgraph shutdown
+static const double MAX_WAIT_SECONDS = 0.1;
+
+// Bits in the count_till_switch field
+static const int COUNT_BITS = 32;
+
+// Shortest interval between two statistics reports
+static const std::chrono::seconds STATS_PERIOD(1);
+
+// Latency histogram bins (powers of two in microseconds, the last one collects everything above ~0.5 s)
+static const int LATENCY_BINS = 20;
+
+// Receive timestamps kept for latency measurement; further packets go unmeasured until general_work catches up
+static const size_t RX_STAMP_CAPACITY = 4096;
+
+// Longest wait for the PPS edge that applies a device time reset (PPS period plus margin)
+static const double PPS_TIMEOUT_SECONDS = 1.5;
+
+// Longest wait for the LOs to report lock after the initial tune
+static const double LO_LOCK_TIMEOUT_SECONDS = 0.5;
+
+// Largest offset of the last PPS edge from a whole second for which the device time still counts as PPS-aligned
+static const double PPS_ALIGN_TOLERANCE = 1e-3;
+
+// Polls `ready` until it holds or `timeout` seconds pass, returns whether it held
+template <typename F>
+static bool poll_until(F ready, double timeout) {
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::duration<double>(timeout);
+  while (!ready()) {
+    if (std::chrono::steady_clock::now() >= deadline)
+      return false;
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
   }
-  return out;
+  return true;
 }
 
-usrp_tx_rx::sptr usrp_tx_rx::make(int channel, float carrier_freq, float sampling_rate, int samps_per_sym, float gain, int packet_len, bool start_tx, const std::vector<gr_complex>& ts_buf)
+usrp_tx_rx::sptr usrp_tx_rx::make(int channel, float carrier_freq, float sampling_rate, int samps_per_sym, float gain, int packet_len, bool start_tx, const std::vector<gr_complex>& ts_buf, const std::string& args, bool rx_thread, int rx_core, float round_seconds, bool full_duplex, const std::vector<int>& rx_channels, bool sc16_output, float rx_burst_guard, float excess_bw)
 {
-    return gnuradio::make_block_sptr<usrp_tx_rx_impl>(channel, carrier_freq, sampling_rate, samps_per_sym, gain, packet_len, start_tx, ts_buf);
+    return gnuradio::make_block_sptr<usrp_tx_rx_impl>(channel, carrier_freq, sampling_rate, samps_per_sym, gain, packet_len, start_tx, ts_buf, args, rx_thread, rx_core, round_seconds, full_duplex, rx_channels, sc16_output, rx_burst_guard, excess_bw);
 }
 
 /*
  * The private constructor
  */
-usrp_tx_rx_impl::usrp_tx_rx_impl(int channel, float carrier_freq, float sampling_rate, int samps_per_sym, float gain, int packet_len, bool start_tx, const std::vector<gr_complex>& ts_buf)
+usrp_tx_rx_impl::usrp_tx_rx_impl(int channel, float carrier_freq, float sampling_rate, int samps_per_sym, float gain, int packet_len, bool start_tx, const std::vector<gr_complex>& ts_buf, const std::string& args, bool rx_thread, int rx_core, float round_seconds, bool full_duplex, const std::vector<int>& rx_channels, bool sc16_output, float rx_burst_guard, float excess_bw)
     : // the input is a sample vector (a single packet, a training sequence)
-      // the output is a sample stream from the USRP, given to self-ref framesync
+      // the outputs are the sample streams of the RX channels, given to self-ref framesync
       gr::block("usrp_tx_rx",
                 gr::io_signature::make(0 /* min inputs */, 0 /* max inputs */, 0),
-                gr::io_signature::make(1 /* min outputs */, 1 /*max outputs */, sizeof(gr_complex))),
-      d_channel(channel),
-      d_carrier_freq(carrier_freq),
+                gr::io_signature::make(std::max<int>(1, rx_channels.size()) /* min outputs */, std::max<int>(1, rx_channels.size()) /*max outputs */,
+                                         sc16_output ? sizeof(std::complex<int16_t>) : sizeof(gr_complex))),
+      d_base_freq(carrier_freq),
       d_sampling_rate(sampling_rate),
-      d_samps_per_sym(samps_per_sym),
       d_gain(gain),
+      d_carrier_freq(carrier_freq),
+      d_lo_freq(carrier_freq),
+      d_channel(channel),
+      d_rx_channels(rx_channels.begin(), rx_channels.end()),
+      d_samps_per_sym(samps_per_sym),
       d_start_tx_mode(start_tx),
       d_tx_mode(start_tx),
       d_packet_len(packet_len),
       d_ts_buf(ts_buf),
-      d_rx_recv_till(0), d_tx_packets_to_send(0)
+      d_modulator(pulse_modulator::OOK, samps_per_sym, excess_bw),
+      d_args(args),
+      d_sc16_output(sc16_output),
+      d_item_size(sc16_output ? sizeof(std::complex<int16_t>) : sizeof(gr_complex)),
+      d_rx_spill_samps(0), d_rx_spill_off(0), d_rx_spill_len(0),
+      d_use_rx_thread(rx_thread), d_rx_core(rx_core),
+      d_rx_thread_stop(false), d_rx_thread_failed(false), d_rx_active(false),
+      d_round_seconds(round_seconds), d_first_round(0), d_round(0), d_rx_windows_pending(0), d_rx_burst_guard(rx_burst_guard),
+      d_full_duplex(full_duplex), d_tx_thread_stop(false),
+      d_dsp_range(0.0),
+      d_overflows(0), d_underflows(0), d_late_commands(0), d_late_bursts(0), d_timeouts(0),
+      d_samples(0), d_tx_packets(0), d_rx_dropped(0),
+      d_rx_stamps(new spsc_ring<rx_stamp>(RX_STAMP_CAPACITY)), d_has_stamp(false),
+      d_latency_hist(LATENCY_BINS, 0)
 {
+  if (d_rx_channels.empty())
+    d_rx_channels.push_back(channel);
+  if (round_seconds <= 2 * (SCHEDULE_LEAD_SECONDS + TUNE_SETTLE_SECONDS))
+    throw std::invalid_argument("usrp_tx_rx: round_seconds is too short to schedule a round");
+
   std::cout << "Carrier freq:" << carrier_freq << " Sampling rate:" << sampling_rate << 
     " Gain:" << gain << " Start in TX Mode:" << start_tx << " Packet length:" << packet_len << " Channel:" << d_channel << std::endl;
 
   // Setup message passing
   message_port_register_in(pmt::intern("msg"));
+  message_port_register_out(pmt::mp("stats"));
+
+  build_tx_cache();
+}
+
+/*
+ * TX Waveform Cache
+ * - The count field is sent as unipolar bits (1 -> 1+0j, 0 -> 0) after the training sequence, least significant bit
+ *   of the least significant byte first. Since shaping is linear, the packet is the shaped training sequence plus the
+ *   shaped bits of each count byte at that byte's offset, filter tails included.
+ */
+void usrp_tx_rx_impl::build_tx_cache() {
+  const int sps = d_samps_per_sym;
+  std::vector<gr_complex> syms(d_ts_buf);
+  syms.resize(d_ts_buf.size() + COUNT_BITS, gr_complex(0.0, 0.0));
+  d_tx_base.resize(syms.size() * sps + d_modulator.tail());
+  d_modulator.shape(&syms.front(), syms.size(), &d_tx_base.front());
+  d_tx_packet.resize(d_tx_base.size());
+  d_tx_count_offset = d_ts_buf.size() * sps;
+
+  d_tx_byte_table.assign(256, std::vector<gr_complex>(8 * sps + d_modulator.tail()));
+  for (int value = 0; value < 256; value++) {
+    uint8_t byte = value;
+    d_modulator.modulate(&byte, 1, &d_tx_byte_table[value].front());
+  }
 }
 
 /*
  * Our virtual destructor.
  */
 usrp_tx_rx_impl::~usrp_tx_rx_impl() {
-  // If in receive mode (TODO change this in the future when I will have both channels open at once)
-  if (!d_tx_mode) {
-    stop_continuous_streaming();
+  stop();
+}
+
+/*
+ * Startup Readiness
+ * - The device time is only reset when it is not already running on the PPS: the last PPS edge must fall on a whole
+ *   second and lie less than a PPS period (plus margin) in the past. A time set by an earlier run, by this or another
+ *   process, is kept, so restarting one node does not move its time base away from its peer's.
+ * - A reset happens at the next PPS edge. It is detected by polling for the reset value (the last PPS reads 0, or the
+ *   time has jumped back below its value before the reset) instead of sleeping a full second.
+ * - LO lock is polled through the "lo_locked" sensors of the front ends that provide one.
+ */
+void usrp_tx_rx_impl::reset_device_time() {
+  double last_pps = d_radio->get_time_last_pps().get_real_secs();
+  double now = d_radio->get_time_now().get_real_secs();
+  bool pps_aligned = last_pps > 0.0 && std::abs(last_pps - std::round(last_pps)) < PPS_ALIGN_TOLERANCE;
+  bool running = now >= last_pps && now - last_pps < PPS_TIMEOUT_SECONDS;
+  if (pps_aligned && running) {
+    std::cout << "Device time already running on the PPS (" << now << " s), skipping the PPS reset" << std::endl;
+    return;
   }
+
+  d_radio->set_time_next_pps(uhd::time_spec_t(0.0));
+  // A last PPS that already read 0 before the reset (no edge seen yet) says nothing, the time jumping back still does
+  bool pps_was_zero = std::abs(last_pps) < PPS_ALIGN_TOLERANCE;
+  auto reset_done = [&] {
+    return (!pps_was_zero && std::abs(d_radio->get_time_last_pps().get_real_secs()) < PPS_ALIGN_TOLERANCE) ||
+           d_radio->get_time_now().get_real_secs() < now;
+  };
+  if (!poll_until(reset_done, PPS_TIMEOUT_SECONDS))
+    std::cout << "USRP Warning: no PPS edge within " << PPS_TIMEOUT_SECONDS << " s, device time may not be reset" << std::endl;
+}
+
+void usrp_tx_rx_impl::wait_lo_locked() {
+  auto has_sensor = [](const std::vector<std::string>& names) {
+    return std::find(names.begin(), names.end(), "lo_locked") != names.end();
+  };
+  std::vector<size_t> rx_chans;
+  for (size_t chan : d_rx_channels)
+    if (has_sensor(d_radio->get_rx_sensor_names(chan)))
+      rx_chans.push_back(chan);
+  bool tx_sensor = has_sensor(d_radio->get_tx_sensor_names(d_channel));
+
+  auto locked = [&] {
+    for (size_t chan : rx_chans)
+      if (!d_radio->get_rx_sensor("lo_locked", chan).to_bool())
+        return false;
+    return !tx_sensor || d_radio->get_tx_sensor("lo_locked", d_channel).to_bool();
+  };
+  if (!poll_until(locked, LO_LOCK_TIMEOUT_SECONDS))
+    std::cout << "USRP Warning: LO not locked after " << LO_LOCK_TIMEOUT_SECONDS << " s" << std::endl;
 }
 
 bool usrp_tx_rx_impl::start() {
   uhd::set_thread_priority_safe();
 
-  uhd::device_addr_t device_args("");
   std::string subdev("A:0 B:0");
   std::string ref("internal");
 
-  // Create a usrp device
-  std::cout << "Searching for all USRP devices..." << std::endl;
-  d_usrp = uhd::usrp::multi_usrp::make(device_args);
+  // Create the radio (a USRP unless the args select the loopback backend)
+  d_radio = radio_backend::make(d_args);
 
   // Lock mboard clocks
   std::cout << "Lock mboard clocks: " << ref << std::endl;
-  d_usrp->set_clock_source(ref);
-  
+  d_radio->set_clock_source(ref);
+  d_radio->set_time_source(ref);
+
   // Always select the subdevice first, the channel mapping affects the other settings
   std::cout << "subdev set to: " << subdev << std::endl;
-  d_usrp->set_rx_subdev_spec(subdev);  // TODO How to use this?
-  std::cout << "Using Device: " << d_usrp->get_pp_string() << std::endl;
+  d_radio->set_rx_subdev_spec(subdev);  // TODO How to use this?
+  std::cout << "Using Device: " << d_radio->get_pp_string() << std::endl;
 
   // Set the sample rate
   if (d_sampling_rate <= 0.0) {
@@ -110,109 +232,398 @@ bool usrp_tx_rx_impl::start() {
   }
 
   // Set the TX gain
-  d_usrp->set_tx_gain(d_gain, d_channel);
+  d_radio->set_tx_gain(d_gain, d_channel);
   // Set the RX gain
-  d_usrp->set_rx_gain(10, d_channel);
+  for (size_t chan : d_rx_channels)
+    d_radio->set_rx_gain(10, chan);
 
   // Set sample rate
-  d_usrp->set_rx_rate(d_sampling_rate, d_channel);
-  d_usrp->set_tx_rate(d_sampling_rate, d_channel);
-  std::cout << "Actual RX Rate: " << d_usrp->get_rx_rate() / 1e6 << " Msps | Actual TX Rate: " << d_usrp->get_tx_rate() / 1e6 << " Msps" << std::endl;
+  for (size_t chan : d_rx_channels)
+    d_radio->set_rx_rate(d_sampling_rate, chan);
+  d_radio->set_tx_rate(d_sampling_rate, d_channel);
+  std::cout << "Actual RX Rate: " << d_radio->get_rx_rate(d_rx_channels[0]) / 1e6 << " Msps | Actual TX Rate: " << d_radio->get_tx_rate(d_channel) / 1e6 << " Msps" << std::endl;
 
-  d_usrp->set_clock_source("internal");
-  d_usrp->set_time_source("internal");
+  // Reset timing unless the device time already runs on the PPS (a restarted flowgraph keeps it)
+  reset_device_time();
 
-  // Reset timing
-  d_usrp->set_time_next_pps(uhd::time_spec_t(0.0));
-  std::this_thread::sleep_for(std::chrono::milliseconds(1000));
-
-  // Use the timed command interface to send a timed command to both channels
-  d_usrp->clear_command_time();
-  d_usrp->set_command_time(d_usrp->get_time_now() + uhd::time_spec_t(0.1));
+  // Tune now and wait for lock; the first round starts at least SCHEDULE_LEAD_SECONDS later
+  d_carrier_freq = d_lo_freq = d_base_freq;
   uhd::tune_request_t tune_request(d_carrier_freq);
-  d_usrp->set_rx_freq(tune_request, d_channel);  // this command will be sent synchronously
-  d_usrp->set_tx_freq(tune_request, d_channel);  // this command will be sent synchronously
-  std::this_thread::sleep_for(std::chrono::milliseconds(110));  // sleep 110ms (~10ms after retune occurs) to allow LO to lock
-  d_usrp->clear_command_time();
-
-  // Create stream to TX and RX antennas on the same channel
-  uhd::stream_args_t stream_args("fc32"); // complex floats
-  stream_args.channels = {(size_t)d_channel};  // Get TX
-  d_tx_stream = d_usrp->get_tx_stream(stream_args);
-  d_rx_stream = d_usrp->get_rx_stream(stream_args);
-  std::cout << "Set up TX and RX streams for channel " << d_channel << std::endl;
-
-  // Setup continuous streaming if starting in TX mode
-  if (!d_tx_mode) {
-    start_continuous_streaming();
-    d_tx_packets_to_send = d_tx_packets_per_round;
-  } else {
-    d_rx_recv_till = std::time(nullptr) + d_rx_seconds_per_round;
+  for (size_t chan : d_rx_channels)
+    d_radio->set_rx_freq(tune_request, chan);
+  d_radio->set_tx_freq(tune_request, d_channel);
+  wait_lo_locked();
+
+  // One TX stream, and one RX stream carrying all RX channels so their samples share timestamps
+  // sc16 output keeps the wire format on the host, so UHD only copies samples instead of converting them
+  uhd::stream_args_t rx_stream_args(d_sc16_output ? "sc16" : "fc32", "sc16");
+  rx_stream_args.channels = d_rx_channels;
+  uhd::stream_args_t tx_stream_args("fc32"); // complex floats
+  tx_stream_args.channels = {(size_t)d_channel};
+  d_radio->setup_streams(rx_stream_args, tx_stream_args);
+  d_rx_spill_samps = d_radio->get_max_num_samps();
+  d_rx_spill.assign(d_rx_channels.size(), std::vector<uint8_t>(d_rx_spill_samps * d_item_size));
+  d_rx_spill_bufs.clear();
+  for (std::vector<uint8_t>& spill : d_rx_spill)
+    d_rx_spill_bufs.push_back(&spill.front());
+  std::cout << "Set up TX stream for channel " << d_channel << " and RX stream for " << d_rx_channels.size() << " channel(s)" << std::endl;
+
+  d_rx_time_refs.clear();
+  d_rx_active = true;
+  if (d_use_rx_thread) {
+    d_rx_rings.clear();
+    for (size_t i = 0; i < d_rx_channels.size(); i++)
+      d_rx_rings.emplace_back(new spsc_ring<uint8_t>(d_sampling_rate * RX_RING_SECONDS * d_item_size));
+    d_rx_thread_stop = false;
+    d_rx_thread = std::thread(&usrp_tx_rx_impl::rx_thread_loop, this);
+  }
+
+  // The first round is the next one that can still be scheduled in time; general_work (or the TX thread) schedules it
+  double now = d_radio->get_time_now().get_real_secs();
+  d_first_round = (long long)std::ceil((now + SCHEDULE_LEAD_SECONDS) / d_round_seconds);
+  d_round = d_first_round - 1;
+
+  if (d_full_duplex) {
+    uhd::stream_cmd_t stream_cmd(uhd::stream_cmd_t::STREAM_MODE_START_CONTINUOUS);
+    stream_cmd.stream_now = false;
+    stream_cmd.time_spec = uhd::time_spec_t(d_first_round * d_round_seconds);
+    {
+      std::lock_guard<std::mutex> lock(d_rx_window_mutex);
+      d_rx_window_starts.clear();
+      d_rx_windows_pending = 0;
+    }
+    rx_window_issued(d_first_round * d_round_seconds);
+    d_radio->issue_stream_cmd(stream_cmd);
+
+    d_tx_thread_stop = false;
+    d_tx_thread = std::thread(&usrp_tx_rx_impl::tx_thread_loop, this);
   }
 
   return true;
 }
 
+bool usrp_tx_rx_impl::stop() {
+  d_tx_thread_stop = true;
+  if (d_tx_thread.joinable())
+    d_tx_thread.join();
+  stop_rx_thread();
+  if (d_radio && d_rx_active)
+    stop_continuous_streaming();
+  return true;
+}
+
+/*
+ * TX Thread (full duplex)
+ * - Owns the schedule so that bursts keep going out while general_work is held up by downstream backpressure.
+ */
+void usrp_tx_rx_impl::tx_thread_loop() {
+  uhd::set_thread_priority_safe();
+  try {
+    while (!d_tx_thread_stop) {
+      double now = d_radio->get_time_now().get_real_secs();
+      if (now >= next_schedule_time()) {
+        advance_schedule(now);
+        continue;
+      }
+      uhd::async_metadata_t async_md;
+      if (d_radio->recv_async_msg(async_md, std::min(MAX_WAIT_SECONDS, next_schedule_time() - now)))
+        report_async(async_md);
+    }
+  } catch (const std::exception& e) {
+    std::cerr << "[Channel " << d_channel << "] TX thread stopped: " << e.what() << std::endl;
+  }
+}
+
+double usrp_tx_rx_impl::next_schedule_time() const {
+  return (d_round + 1) * d_round_seconds - SCHEDULE_LEAD_SECONDS;
+}
+
+// Issues the next round, skipping rounds that can no longer be scheduled in time (e.g. after a long stall)
+void usrp_tx_rx_impl::advance_schedule(double now) {
+  long long round = std::max(d_round + 1, (long long)std::ceil((now + TUNE_SETTLE_SECONDS) / d_round_seconds));
+  if (round != d_round + 1)
+    printf("[Channel %d] Skipping %lld late round(s)\n", d_channel, round - d_round - 1);
+  schedule_round(round);
+}
+
+/*
+ * Round Scheduling
+ * - Issues everything a round needs as timed commands, in time order: the round's carrier segments (one per exchange,
+ *   or the hop plan's dwells) each start with a retune if the carrier changes, then either the segment's ranging
+ *   packets or, once, a receive window that ends where the next round begins. Packets count down to the switch so
+ *   receivers can follow the schedule, and every segment is tagged "rx_freq" where its carrier is settled.
+ * - In full duplex every round is an exchange: RX is already streaming, and the packets go into this node's half of
+ *   each segment.
+ */
+void usrp_tx_rx_impl::schedule_round(long long round) {
+  double start = round * d_round_seconds;
+  double end = start + d_round_seconds;
+  bool tx = d_full_duplex || (round % 2 == 0) == d_start_tx_mode;
+
+  // Carrier segments of the round as (start, end, frequency)
+  std::vector<std::tuple<double, double, double>> segments;
+  double dsp_range;
+  int packets_per_segment;
+  {
+    std::lock_guard<std::mutex> lock(d_plan_mutex);
+    dsp_range = d_dsp_range;
+    if (d_hop_freqs.empty()) {
+      // Frequency depends only on the exchange index, so skipped rounds cannot desynchronize the hop sequence
+      long long exchange = d_full_duplex ? round - d_first_round : round / 2 - d_first_round / 2;
+      segments.emplace_back(start, end, d_base_freq + HOP_STEP_HZ * exchange);
+      packets_per_segment = d_tx_packets_per_round;
+    } else {
+      // The plan restarts every round, so both nodes of an exchange visit the same carriers at the same times
+      double t = start;
+      for (size_t i = 0; t + d_hop_dwells[i] <= end; i = (i + 1) % d_hop_freqs.size()) {
+        segments.emplace_back(t, t + d_hop_dwells[i], d_hop_freqs[i]);
+        t += d_hop_dwells[i];
+      }
+      packets_per_segment = 1;
+    }
+  }
+
+  printf("[Channel %d] %s round %lld at %.3f s (%zu carrier(s))\n", d_channel,
+         d_full_duplex ? "Full-duplex" : tx ? "TX" : "RX", round, start, segments.size());
+  int count = segments.size() * packets_per_segment;
+  double rx_window_end = start;
+  for (size_t seg_i = 0; seg_i < segments.size(); seg_i++) {
+    double seg_start, seg_end, freq;
+    std::tie(seg_start, seg_end, freq) = segments[seg_i];
+    double active = seg_start;
+    if (freq != d_carrier_freq)
+      active += hop_frequency(freq, seg_start, dsp_range);
+    queue_tag(active, pmt::intern("rx_freq"), pmt::from_double(d_carrier_freq));
+
+    if (d_full_duplex) {
+      double half = (seg_end - active) / 2;
+      double slot = active + (d_start_tx_mode ? 0.0 : half);
+      double spacing = half / packets_per_segment;
+      for (int i = 0; i < packets_per_segment; i++, count--) {
+        send_ranging_packet(count, gr_complex(0.0, 0.0), 1, slot + i * spacing);
+        queue_tag(slot + i * spacing, pmt::intern("tx_burst"), pmt::from_long(count));
+      }
+    } else if (tx) {
+      double spacing = (seg_end - active) / packets_per_segment;
+      for (int i = 0; i < packets_per_segment; i++, count--)
+        send_ranging_packet(count, gr_complex(0.0, 0.0), 1, active + i * spacing);
+    } else if (d_rx_burst_guard > 0) {
+      // Burst mode: only receive around the packets the peer sends in this segment (windows must not overlap, or
+      // the later one would start late)
+      double spacing = (seg_end - active) / packets_per_segment;
+      double packet_seconds = d_tx_packet.size() / d_sampling_rate;
+      for (int i = 0; i < packets_per_segment; i++) {
+        double from = std::max(rx_window_end, active + i * spacing - d_rx_burst_guard);
+        double to = std::min(seg_end, active + i * spacing + packet_seconds + d_rx_burst_guard);
+        if (to > from) {
+          issue_rx_window(from, to);
+          rx_window_end = to;
+        }
+      }
+    } else if (seg_i == 0) {
+      issue_rx_window(active, end);
+    }
+  }
+  d_tx_mode = tx;
+  d_round = round;
+}
+
+// Receives from device time `from` until `to`
+void usrp_tx_rx_impl::issue_rx_window(double from, double to) {
+  uhd::stream_cmd_t stream_cmd(uhd::stream_cmd_t::STREAM_MODE_NUM_SAMPS_AND_DONE);
+  stream_cmd.num_samps = (size_t)((to - from) * d_sampling_rate);
+  stream_cmd.stream_now = false;
+  stream_cmd.time_spec = uhd::time_spec_t(from);
+  rx_window_issued(from);
+  d_radio->issue_stream_cmd(stream_cmd);
+}
+
+void usrp_tx_rx_impl::rx_window_issued(double start) {
+  std::lock_guard<std::mutex> lock(d_rx_window_mutex);
+  d_rx_window_starts.push_back(start);
+  d_rx_windows_pending++;
+}
+
+void usrp_tx_rx_impl::rx_window_done() {
+  std::lock_guard<std::mutex> lock(d_rx_window_mutex);
+  if (d_rx_window_starts.empty())
+    return;
+  d_rx_window_starts.pop_front();
+  d_rx_windows_pending--;
+}
+
+bool usrp_tx_rx_impl::rx_window_overdue(double since) {
+  std::lock_guard<std::mutex> lock(d_rx_window_mutex);
+  return !d_rx_window_starts.empty() && since >= d_rx_window_starts.front() + d_rx_burst_guard;
+}
+
+// Tags are kept in time order; received timestamps arrive after tags that were scheduled ahead
+void usrp_tx_rx_impl::queue_tag(double at, const pmt::pmt_t& key, const pmt::pmt_t& value) {
+  std::lock_guard<std::mutex> lock(d_tag_mutex);
+  auto pos = d_pending_tags.end();
+  while (pos != d_pending_tags.begin() && std::get<0>(*(pos - 1)) > at)
+    --pos;
+  d_pending_tags.emplace(pos, at, key, value);
+}
+
+// Places the queued tags that fall into the n_written items just produced
+void usrp_tx_rx_impl::add_pending_tags(int n_written) {
+  uint64_t first = nitems_written(0);
+  std::lock_guard<std::mutex> lock(d_tag_mutex);
+  while (d_rx_time_refs.size() > 1 && d_rx_time_refs[1].second <= first)
+    d_rx_time_refs.pop_front();  // That stretch has been produced completely
+  while (!d_pending_tags.empty() && !d_rx_time_refs.empty()) {
+    // The tag belongs to the last stretch that started at or before its time
+    double at = std::get<0>(d_pending_tags.front());
+    auto ref = std::upper_bound(d_rx_time_refs.begin(), d_rx_time_refs.end(), at,
+                                [](double t, const std::pair<double, uint64_t>& r) { return t < r.first; });
+    bool received = ref != d_rx_time_refs.begin();
+    if (received) {
+      double item = (ref - 1)->second + std::round((at - (ref - 1)->first) * d_sampling_rate);
+      if (ref == d_rx_time_refs.end() && item >= first + n_written)
+        break;
+      // Otherwise the time fell into a gap before the next stretch, or before what is left to produce
+      received = (ref == d_rx_time_refs.end() || item < ref->second) && item >= first;
+      if (received) {
+        for (size_t i = 0; i < d_rx_channels.size(); i++)
+          add_item_tag(i, (uint64_t)item, std::get<1>(d_pending_tags.front()), std::get<2>(d_pending_tags.front()));
+      }
+    }
+    d_pending_tags.pop_front();
+  }
+}
+void usrp_tx_rx_impl::report_async(const uhd::async_metadata_t& md) {
+  switch (md.event_code) {
+  case uhd::async_metadata_t::EVENT_CODE_BURST_ACK:
+    break;
+  case uhd::async_metadata_t::EVENT_CODE_UNDERFLOW:
+  case uhd::async_metadata_t::EVENT_CODE_UNDERFLOW_IN_PACKET:
+    d_underflows++;
+    std::cout << "USRP Error: TX underflow\n" << std::flush;
+    break;
+  case uhd::async_metadata_t::EVENT_CODE_TIME_ERROR:
+    d_late_bursts++;
+    std::cout << "USRP Error: TX burst was late\n" << std::flush;
+    break;
+  default:
+    std::cout << "USRP Error: TX event " << md.event_code << "\n" << std::flush;
+  }
+}
+
+void usrp_tx_rx_impl::stop_rx_thread() {
+  d_rx_thread_stop = true;
+  if (d_rx_thread.joinable())
+    d_rx_thread.join();
+}
+
+/*
+ * RX Thread
+ * - Receives whatever the ring has room for while streaming is active. When the ring is full (the flowgraph has
+ *   stalled for RX_RING_SECONDS), packets are received into the spill buffer and dropped so the device never overflows.
+ */
+void usrp_tx_rx_impl::rx_thread_loop() {
+  if (d_rx_core >= 0)
+    gr::thread::thread_bind_to_processor(d_rx_core);
+  uhd::set_thread_priority_safe();
+
+  bool dropping = false;
+  std::vector<void*> dsts(d_rx_rings.size());
+  try {
+    while (!d_rx_thread_stop) {
+      if (!d_rx_active) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        continue;
+      }
+
+      // The rings are written in lockstep, so they all have the same contiguous space (a whole number of samples,
+      // since the capacity is a power of two and so is the sample size)
+      size_t space;
+      for (size_t i = 0; i < d_rx_rings.size(); i++)
+        dsts[i] = d_rx_rings[i]->write_ptr(space);
+      space /= d_item_size;
+      uint64_t item = d_rx_rings[0]->total_written() / d_item_size;
+      if (space == 0) {
+        if (!dropping)
+          std::printf("[Channel %d] RX ring full, dropping samples\n", d_channel);
+        dropping = true;
+        d_rx_dropped += recv_into_buf(d_rx_spill_bufs, d_rx_spill_samps, RX_THREAD_TIMEOUT, item);
+        continue;
+      }
+      dropping = false;
+
+      size_t n = recv_into_buf(dsts, space, RX_THREAD_TIMEOUT, item);
+      if (n > 0) {
+        for (auto& ring : d_rx_rings)
+          ring->commit_write(n * d_item_size);
+        stamp_rx(item + n);
+        { std::lock_guard<std::mutex> lock(d_rx_mutex); }
+        d_rx_cond.notify_one();
+      }
+    }
+  } catch (const std::exception& e) {
+    std::cerr << "[Channel " << d_channel << "] RX thread stopped: " << e.what() << std::endl;
+    d_rx_thread_failed = true;
+    d_rx_cond.notify_one();
+  }
+}
+
 /* 
  * Send a Ranging Packet
  * - This function takes three packet fields, the training sequence, the count-till-switch, and the previous channel estimate, and assembles
- *   them into a sequence of bits which are passed through an RRC filter. The complex buffer is then transmitted over the air to listening USRPs.
+ *   them from the TX waveform cache. The complex buffer is then transmitted over the air to listening USRPs.
  */
-void usrp_tx_rx_impl::send_ranging_packet(const std::vector<gr_complex>& ts_buf, int count_till_switch, gr_complex prev_chan_est, int repetition = 1) {
-  // Assemble symbol buffer (TODO send previous channel estimate over the air)
-  std::vector<gr_complex> payload(ts_buf);
-  char* int_bits = reinterpret_cast<char*>(&count_till_switch);
-  for (std::size_t char_i = 0; char_i < sizeof(count_till_switch); char_i++) {
-    auto char_in_int_bits = std::bitset<8>(int_bits[char_i]);
-    // Another for loop to add each bit into the payload
-    for (int bit_i = 0; bit_i < 8; bit_i++) {
-      payload.push_back(gr_complex(static_cast<int>(char_in_int_bits[bit_i]), 0.0));
-    }
+void usrp_tx_rx_impl::send_ranging_packet(int count_till_switch, gr_complex prev_chan_est, int repetition, double at) {
+  // Assemble the packet (TODO send previous channel estimate over the air)
+  std::copy(d_tx_base.begin(), d_tx_base.end(), d_tx_packet.begin());
+  uint32_t count = count_till_switch;
+  for (int byte_i = 0; byte_i < COUNT_BITS / 8; byte_i++) {
+    const std::vector<gr_complex>& contribution = d_tx_byte_table[(count >> (8 * byte_i)) & 0xff];
+    gr_complex* dst = &d_tx_packet[d_tx_count_offset + 8 * byte_i * d_samps_per_sym];
+    for (size_t k = 0; k < contribution.size(); k++)
+      dst[k] += contribution[k];
   }
 
-  auto payload_up = upsample(payload, d_samps_per_sym);
-  auto payload_filtered = rrc_filter(payload_up, d_sampling_rate, d_samps_per_sym, 11*d_samps_per_sym);
-  
-  // Format TX packet metadata to send packet 100ms in the future so that the USRP does not get overwhelmed
+  // Repetitions follow back to back and the last one ends the burst
   uhd::tx_metadata_t md;
-  md.start_of_burst = false;
+  md.start_of_burst = true;
   md.end_of_burst = false;
   md.has_time_spec = true;
-  md.time_spec = d_usrp->get_time_now() + uhd::time_spec_t(0.1);
+  md.time_spec = uhd::time_spec_t(at);
   size_t num_sent_samps = 0;
 
-  // Print bits of payload
-  // std::cout << "Payload: ";
-  // for (auto samp : payload_filtered) {
-  //   std::cout << samp << " ";
-  // }
-  // std::cout << std::endl;
-  // std::cout << "Sending packet of length " << payload_filtered.size() << std::endl;
-
-  for (int i = 0; i < repetition; i++)
-    num_sent_samps += d_tx_stream->send(&payload_filtered.front(), payload_filtered.size(), md, 1);
-  if (num_sent_samps != payload_filtered.size()*repetition) {
+  for (int i = 0; i < repetition; i++) {
+    md.end_of_burst = (i == repetition - 1);
+    num_sent_samps += d_radio->send(&d_tx_packet.front(), d_tx_packet.size(), md, 1);
+    md.start_of_burst = false;
+    md.has_time_spec = false;
+  }
+  d_tx_packets++;
+  if (num_sent_samps != d_tx_packet.size()*repetition) {
     throw std::runtime_error("The number of sent samples does not equal the desired packet length");
   }
-
-  // Send EOB to tell the USRP to stop waiting on TX packets
-  md.time_spec = d_usrp->get_time_now() + uhd::time_spec_t(0.1);
-  md.end_of_burst = true;
-  d_tx_stream->send("", 0, md, 0.1);
 }
 
-size_t usrp_tx_rx_impl::recv_into_buf(std::vector<gr_complex> &buf, const size_t n) {
+size_t usrp_tx_rx_impl::recv_into_buf(const std::vector<void*>& bufs, const size_t n, double timeout, uint64_t item) {
   uhd::rx_metadata_t md;
 
-  const size_t num_rx_samps = d_rx_stream->recv(&buf.front(), n, md, 3.0);
+  const size_t num_rx_samps = d_radio->recv(bufs, n, md, timeout);
 
-  // Error handling
+  // Error handling (timeouts are normal while waiting for a scheduled window, so only count those where the
+  // window had already started when recv began waiting)
   if (md.error_code == uhd::rx_metadata_t::ERROR_CODE_TIMEOUT) {
-    std::cout << "USRP Error: timeout while streaming\n" << std::flush;
+    if (d_rx_windows_pending > 0 && rx_window_overdue(d_radio->get_time_now().get_real_secs() - timeout))
+      d_timeouts++;
+    return 0;
+  }
+  if (md.error_code == uhd::rx_metadata_t::ERROR_CODE_LATE_COMMAND) {
+    std::cout << "USRP Error: RX window started late\n" << std::flush;
+    d_late_commands++;
+    rx_window_done();
     return 0;
   }
   if (md.error_code == uhd::rx_metadata_t::ERROR_CODE_OVERFLOW) {
     std::cout << "USRP Error: overflow\n" << std::flush;
+    d_overflows++;
     return 0;
   }
   if (md.error_code != uhd::rx_metadata_t::ERROR_CODE_NONE) {
@@ -220,47 +631,200 @@ size_t usrp_tx_rx_impl::recv_into_buf(std::vector<gr_complex> &buf, const size_t
     std::cout << "USRP Error: " << md.error_code << "\n" << std::flush;
     throw std::runtime_error("USRP Error: receiver error");
   }
+  if (md.end_of_burst)
+    rx_window_done();
+  if (num_rx_samps > 0 && md.has_time_spec) {
+    // Tag the start of every burst, and any gap in the stream, with its device time (as gr-uhd does)
+    double t = md.time_spec.get_real_secs();
+    bool gap;
+    {
+      std::lock_guard<std::mutex> lock(d_tag_mutex);
+      gap = d_rx_time_refs.empty() ||
+            std::abs(t - d_rx_time_refs.back().first - ((double)item - (double)d_rx_time_refs.back().second) / d_sampling_rate) > 0.5 / d_sampling_rate;
+      if (gap)
+        d_rx_time_refs.emplace_back(t, item);
+    }
+    if (gap)
+      queue_tag(t, pmt::intern("rx_time"), pmt::make_tuple(pmt::from_uint64(md.time_spec.get_full_secs()),
+                                                            pmt::from_double(md.time_spec.get_frac_secs())));
+  }
 
   return num_rx_samps;
 }
 
-void usrp_tx_rx_impl::start_continuous_streaming() {
-  // Send continuous streaming command
-  uhd::stream_cmd_t stream_cmd(uhd::stream_cmd_t::STREAM_MODE_START_CONTINUOUS);
-  stream_cmd.num_samps = 0;
-  stream_cmd.stream_now = false;
-  stream_cmd.time_spec = uhd::time_spec_t(d_usrp->get_time_now() + uhd::time_spec_t(0.5));
-  std::cout << "Issuing stream command to continuously stream from RX on channel " << d_channel << std::flush << std::endl;
-  d_rx_stream->issue_stream_cmd(stream_cmd);
-  std::this_thread::sleep_for(std::chrono::milliseconds(500));
-}
-
-void usrp_tx_rx_impl::hop_frequency(float new_frequency) {
-  // TODO: Figure out if I need to re-initialize the TX and RX streams after hopping frequency
-  std::printf("[Channel %d] Hopping to %f\n", d_channel, new_frequency);
-  d_usrp->clear_command_time();
-  d_usrp->set_command_time(d_usrp->get_time_now() + uhd::time_spec_t(0.1));
-
-  // Tune TX and RX synchronously
+/*
+ * Frequency Hopping
+ * - Hops within dsp_range of the current LO keep the LO where it is (manual RF policy) and retune only the DSP, which
+ *   takes effect immediately. Anything further moves the LO, which then has to relock, and re-applies the gains.
+ */
+double usrp_tx_rx_impl::hop_frequency(double new_frequency, double at, double dsp_range) {
   uhd::tune_request_t tune_request(new_frequency);
-  d_usrp->set_rx_freq(tune_request, d_channel);  // this command will be sent synchronously
-  d_usrp->set_tx_freq(tune_request, d_channel);  // this command will be sent synchronously
+  bool dsp_only = std::abs(new_frequency - d_lo_freq) <= dsp_range;
+  if (dsp_only) {
+    tune_request.rf_freq_policy = uhd::tune_request_t::POLICY_MANUAL;
+    tune_request.rf_freq = d_lo_freq;
+    tune_request.dsp_freq_policy = uhd::tune_request_t::POLICY_AUTO;
+  } else {
+    std::printf("[Channel %d] Retuning LO to %f at %.3f s\n", d_channel, new_frequency, at);
+  }
 
-  std::this_thread::sleep_for(std::chrono::milliseconds(110));  // sleep 110ms (~10ms after retune occurs) to allow LO to lock
-  d_usrp->clear_command_time();
-    // Set the TX gain
-  d_usrp->set_tx_gain(d_gain, d_channel);
-  // Set the RX gain
-  d_usrp->set_rx_gain(10, d_channel);
+  // Tune TX and RX synchronously
+  d_radio->set_command_time(uhd::time_spec_t(at));
+  for (size_t chan : d_rx_channels)
+    d_radio->set_rx_freq(tune_request, chan);
+  d_radio->set_tx_freq(tune_request, d_channel);
+  if (!dsp_only) {
+    d_radio->set_tx_gain(d_gain, d_channel);
+    for (size_t chan : d_rx_channels)
+      d_radio->set_rx_gain(10, chan);
+    d_lo_freq = new_frequency;
+  }
+  d_radio->clear_command_time();
 
   d_carrier_freq = new_frequency;
+  return dsp_only ? 0.0 : TUNE_SETTLE_SECONDS;
+}
+
+void usrp_tx_rx_impl::set_hop_plan(const std::vector<double>& freqs, const std::vector<double>& dwell_seconds, double dsp_range) {
+  if (freqs.size() != dwell_seconds.size())
+    throw std::invalid_argument("usrp_tx_rx: hop plan needs one dwell time per carrier");
+  if (dsp_range < 0.0)
+    throw std::invalid_argument("usrp_tx_rx: dsp_range must not be negative");
+  // Every dwell must fit a retune plus one packet (one per node in full duplex) and still fit into a round
+  double min_dwell = TUNE_SETTLE_SECONDS + (d_full_duplex ? 2 : 1) * d_tx_base.size() / d_sampling_rate;
+  for (double dwell : dwell_seconds) {
+    if (dwell < min_dwell || dwell > d_round_seconds)
+      throw std::invalid_argument("usrp_tx_rx: hop plan dwell times must be between " + std::to_string(min_dwell) +
+                                  " s and round_seconds");
+  }
+
+  std::lock_guard<std::mutex> lock(d_plan_mutex);
+  d_hop_freqs = freqs;
+  d_hop_dwells = dwell_seconds;
+  d_dsp_range = dsp_range;
 }
 
 // This function should only be needed on exiting the program, not when switching between TX & RX
 void usrp_tx_rx_impl::stop_continuous_streaming() {
   uhd::stream_cmd_t stream_cmd(uhd::stream_cmd_t::STREAM_MODE_STOP_CONTINUOUS);
   std::cout << "Stopping continuous streaming from RX on channel " << d_channel << std::endl << std::flush;
-  d_rx_stream->issue_stream_cmd(stream_cmd);
+  d_rx_active = false;
+  d_radio->issue_stream_cmd(stream_cmd);
+}
+
+int usrp_tx_rx_impl::receive(const std::vector<void*>& outs, int noutput_items, double timeout)
+{
+  // Hand out what is left of a packet that did not fit into the previous output buffers
+  int n_written_samps = std::min((int)(d_rx_spill_len - d_rx_spill_off), noutput_items);
+  for (size_t i = 0; i < outs.size(); i++)
+    std::memcpy(outs[i], &d_rx_spill[i][d_rx_spill_off * d_item_size], n_written_samps * d_item_size);
+  d_rx_spill_off += n_written_samps;
+  if (d_rx_windows_pending == 0)
+    return n_written_samps;  // The window has ended, only its spilled tail was left
+
+  // Pull samples from the USRP straight into the output buffers. With less room than one packet, receive a whole
+  // packet into the spill buffers instead so the device is not drained in tiny pieces.
+  int space = noutput_items - n_written_samps;
+  if (space >= (int)d_rx_spill_samps) {
+    std::vector<void*> dsts(outs.size());
+    for (size_t i = 0; i < outs.size(); i++)
+      dsts[i] = static_cast<uint8_t*>(outs[i]) + n_written_samps * d_item_size;
+    size_t n = recv_into_buf(dsts, space, timeout, nitems_written(0) + n_written_samps);
+    n_written_samps += n;
+    if (n > 0)
+      stamp_rx(nitems_written(0) + n_written_samps);
+  } else if (n_written_samps == 0) {
+    d_rx_spill_len = recv_into_buf(d_rx_spill_bufs, d_rx_spill_samps, timeout, nitems_written(0));
+    if (d_rx_spill_len > 0)
+      stamp_rx(nitems_written(0) + d_rx_spill_len);
+    n_written_samps = std::min((int)d_rx_spill_len, noutput_items);
+    for (size_t i = 0; i < outs.size(); i++)
+      std::memcpy(outs[i], &d_rx_spill[i].front(), n_written_samps * d_item_size);
+    d_rx_spill_off = n_written_samps;
+  }
+  return n_written_samps;
+}
+
+// Samples available in all RX rings
+size_t usrp_tx_rx_impl::rx_rings_size() const {
+  size_t n = d_rx_rings[0]->size();
+  for (const auto& ring : d_rx_rings)
+    n = std::min(n, ring->size());
+  return n / d_item_size;
+}
+
+/*
+ * Telemetry
+ * - Every received packet leaves a timestamp (with the output item just past it) in d_rx_stamps; once general_work
+ *   has produced up to that item, the time since recv returned goes into the latency histogram. Without the RX thread
+ *   this is the time spent in the spill buffer, with it the time spent in the ring.
+ */
+void usrp_tx_rx_impl::stamp_rx(uint64_t item_end) {
+  size_t space;
+  rx_stamp* dst = d_rx_stamps->write_ptr(space);
+  if (space == 0)
+    return;
+  dst->item_end = item_end;
+  dst->time = std::chrono::steady_clock::now();
+  d_rx_stamps->commit_write(1);
+}
+
+void usrp_tx_rx_impl::record_latency(uint64_t produced_end) {
+  auto now = std::chrono::steady_clock::now();
+  while (d_has_stamp || d_rx_stamps->read(&d_stamp, 1) == 1) {
+    d_has_stamp = true;
+    if (d_stamp.item_end > produced_end)
+      return;
+    long long us = std::chrono::duration_cast<std::chrono::microseconds>(now - d_stamp.time).count();
+    int bin = 0;
+    while (bin < LATENCY_BINS - 1 && (1LL << (bin + 1)) <= us)
+      bin++;
+    d_latency_hist[bin]++;
+    d_has_stamp = false;
+  }
+}
+
+void usrp_tx_rx_impl::report_stats() {
+  auto now = std::chrono::steady_clock::now();
+  if (now - d_last_report < STATS_PERIOD)
+    return;
+  d_last_report = now;
+
+  pmt::pmt_t stats = pmt::make_dict();
+  stats = pmt::dict_add(stats, pmt::mp("overflows"), pmt::from_uint64(d_overflows));
+  stats = pmt::dict_add(stats, pmt::mp("underflows"), pmt::from_uint64(d_underflows));
+  stats = pmt::dict_add(stats, pmt::mp("late_commands"), pmt::from_uint64(d_late_commands));
+  stats = pmt::dict_add(stats, pmt::mp("late_bursts"), pmt::from_uint64(d_late_bursts));
+  stats = pmt::dict_add(stats, pmt::mp("timeouts"), pmt::from_uint64(d_timeouts));
+  stats = pmt::dict_add(stats, pmt::mp("samples"), pmt::from_uint64(d_samples));
+  stats = pmt::dict_add(stats, pmt::mp("tx_packets"), pmt::from_uint64(d_tx_packets));
+  stats = pmt::dict_add(stats, pmt::mp("rx_dropped"), pmt::from_uint64(d_rx_dropped));
+  stats = pmt::dict_add(stats, pmt::mp("latency_hist"), pmt::init_u64vector(d_latency_hist.size(), d_latency_hist));
+  message_port_pub(pmt::mp("stats"), stats);
+}
+
+void usrp_tx_rx_impl::setup_rpc() {
+#ifdef GR_CTRLPORT
+  struct counter {
+    const char* name;
+    long (usrp_tx_rx::*get)() const;
+    const char* desc;
+  };
+  const counter counters[] = {
+    { "overflows", &usrp_tx_rx::overflows, "RX overflows" },
+    { "underflows", &usrp_tx_rx::underflows, "TX underflows" },
+    { "late_commands", &usrp_tx_rx::late_commands, "RX windows that started late" },
+    { "late_bursts", &usrp_tx_rx::late_bursts, "TX bursts that were late" },
+    { "timeouts", &usrp_tx_rx::timeouts, "recv timeouts after a window should have started" },
+    { "samples_delivered", &usrp_tx_rx::samples_delivered, "Samples produced per output" },
+    { "tx_packets", &usrp_tx_rx::tx_packets, "Ranging packets sent" },
+    { "rx_dropped", &usrp_tx_rx::rx_dropped, "Samples dropped while the RX ring was full" },
+  };
+  for (const counter& c : counters) {
+    add_rpc_variable(rpcbasic_sptr(new rpcbasic_register_get<usrp_tx_rx, long>(
+      alias(), c.name, c.get, pmt::mp(0L), pmt::mp(0L), pmt::mp(0L), "", c.desc, RPC_PRIVLVL_MIN, DISPTIME)));
+  }
+#endif
 }
 
 void usrp_tx_rx_impl::forecast(int noutput_items, gr_vector_int& ninput_items_required)
@@ -274,45 +838,51 @@ int usrp_tx_rx_impl::general_work(int noutput_items,
                                   gr_vector_void_star& output_items)
 {
   // auto in = static_cast<const gr_complex *>(input_items[0]);
-  auto out = static_cast<gr_complex *>(output_items[0]);
-
-  if (d_tx_mode) {
-    // Send internal training sequence
-    std::cout << "Sending ranging packet on channel " << d_channel << std::endl;
-    send_ranging_packet(d_ts_buf, d_tx_packets_to_send, gr_complex(0.0, 0.0), 1);
-    std::this_thread::sleep_for(std::chrono::milliseconds(800));
-    d_tx_packets_to_send--;
-    produce(0, 0);
-
-    // Switch off to receive mode when the packet counter reaches 0
-    if (d_tx_packets_to_send < 1) {
-      printf("[Channel %d] Switching to RX mode\n", d_channel);
-      d_tx_mode = false;
-      if (!d_start_tx_mode)  // If we have made one round of RX then TX
-        hop_frequency(d_carrier_freq + 100e6);
-      d_rx_recv_till = std::time(nullptr) + d_rx_seconds_per_round;  // Start streaming timer
-      start_continuous_streaming();
-    }
-  } else {
-    // Pull samples from the USRP and write them to the temporary vector, then into the output
-    std::vector<gr_complex> buf(noutput_items);
-    size_t num_recv_samps = recv_into_buf(buf, noutput_items);
-
-    int n_written_samps = std::min((int)num_recv_samps, noutput_items);
-    std::copy(buf.begin(), buf.begin() + n_written_samps, out);
-    
-    produce(0, n_written_samps);
-
-    if (std::time(nullptr) > d_rx_recv_till) {
-      printf("[Channel %d] Switching to TX mode\n", d_channel);
-      d_tx_mode = true;
-      stop_continuous_streaming();
-      if (d_start_tx_mode)  // If we have made one round of TX then RX
-        hop_frequency(d_carrier_freq + 100e6);
-      d_tx_packets_to_send = d_tx_packets_per_round;
+  d_out_bufs.resize(output_items.size());
+  for (size_t i = 0; i < output_items.size(); i++)
+    d_out_bufs[i] = output_items[i];
+
+  // Issue the next round's commands once it is within the scheduling lead (the TX thread does this in full duplex)
+  double wait = MAX_WAIT_SECONDS;
+  uhd::async_metadata_t async_md;
+  if (!d_full_duplex) {
+    double now = d_radio->get_time_now().get_real_secs();
+    if (now >= next_schedule_time())
+      advance_schedule(now);
+    wait = std::min(MAX_WAIT_SECONDS, std::max(0.001, next_schedule_time() - now));
+
+    while (d_radio->recv_async_msg(async_md, 0.0))
+      report_async(async_md);
+  }
+
+  int n_written_samps = 0;
+  if (!d_rx_rings.empty()) {
+    // Copy out of the RX thread's rings, waiting briefly for samples if they are empty
+    if (rx_rings_size() == 0) {
+      std::unique_lock<std::mutex> lock(d_rx_mutex);
+      d_rx_cond.wait_for(lock, std::chrono::duration<double>(wait),
+                         [this] { return rx_rings_size() > 0 || d_rx_thread_failed; });
+      lock.unlock();
+      if (d_rx_thread_failed)
+        throw std::runtime_error("USRP Error: receiver error");
     }
+    n_written_samps = std::min((size_t)noutput_items, rx_rings_size());
+    for (size_t i = 0; i < d_rx_rings.size(); i++)
+      d_rx_rings[i]->read(static_cast<uint8_t *>(d_out_bufs[i]), n_written_samps * d_item_size);
+  } else if (d_rx_windows_pending > 0 || d_rx_spill_off < d_rx_spill_len) {
+    n_written_samps = receive(d_out_bufs, noutput_items, wait);
+  } else if (d_radio->recv_async_msg(async_md, wait)) {
+    // Nothing to receive: wait for the queued bursts to go out instead
+    report_async(async_md);
   }
 
+  add_pending_tags(n_written_samps);
+  for (size_t i = 0; i < output_items.size(); i++)
+    produce(i, n_written_samps);
+  d_samples += n_written_samps;
+  record_latency(nitems_written(0) + n_written_samps);
+  report_stats();
+
   // Tell runtime system how many output items we produced.
   return WORK_CALLED_PRODUCE;
 }
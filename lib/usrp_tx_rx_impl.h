@@ -12,60 +12,159 @@
 #include <vector>
 #include <uhd/utils/thread_priority.hpp>
 #include <uhd/utils/safe_main.hpp>
-#include <uhd/usrp/multi_usrp.hpp>
 #include <uhd/exception.hpp>
 #include <uhd/types/tune_request.hpp>
+#include "radio_backend.h"
+#include "spsc_ring.h"
+#include "pulse_modulator.h"
 #include <chrono>
 #include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <memory>
+#include <cstdint>
+#include <deque>
+#include <tuple>
 #include <iostream>
 #include <fstream>
 #include <ctime>
 
 namespace gr {
   namespace radar_dsp {
-    /*
-     * Matched Filter Convolution
-     */
-    std::vector<gr_complex> rrc_filter(std::vector<gr_complex>& buf, float samp_rate, int samps_per_sym, int num_taps);
-
-    /*
-     * Upsampling
-     */
-    std::vector<gr_complex> upsample(const std::vector<gr_complex> &in_buf, int upsampling_rate);
-
     class usrp_tx_rx_impl : public usrp_tx_rx
     {
      private:
-      float d_carrier_freq, d_sampling_rate, d_gain;
-      int d_channel;
+      float d_base_freq, d_sampling_rate, d_gain;
+      double d_carrier_freq;  // Frequency of the latest tune
+      double d_lo_freq;       // RF (LO) frequency of the latest tune
+      int d_channel;                     // TX channel
+      std::vector<size_t> d_rx_channels;  // RX channels, one output each
       int d_samps_per_sym;
       bool d_start_tx_mode, d_tx_mode;
       int d_packet_len;
       const std::vector<gr_complex> d_ts_buf;
       std::vector<gr_complex> d_ts_mf_buf;
-      uhd::rx_streamer::sptr d_rx_stream;
-      uhd::tx_streamer::sptr d_tx_stream;
-      uhd::usrp::multi_usrp::sptr d_usrp;
-      int d_tx_packets_to_send, d_tx_packets_per_round = 5;
-      int d_rx_recv_till, d_rx_seconds_per_round = 5;
+
+      // TX waveform cache: the shaped training sequence (with an all-zero count field) plus, for every byte value,
+      // the shaped contribution of that byte's 8 count bits. A packet is the base plus four table entries.
+      pulse_modulator d_modulator;
+      std::vector<gr_complex> d_tx_base;
+      std::vector<std::vector<gr_complex>> d_tx_byte_table;
+      std::vector<gr_complex> d_tx_packet;
+      size_t d_tx_count_offset;  // Sample offset of the count field's first symbol
+      void build_tx_cache();
+      std::string d_args;
+      radio_backend::uptr d_radio;  // USRP or software loopback, chosen by d_args
+      bool d_sc16_output;
+      size_t d_item_size;  // Bytes per output sample (gr_complex, or std::complex<int16_t> with sc16 output)
+      std::vector<std::vector<uint8_t>> d_rx_spill;  // One RX packet per channel, used only when the output buffers have less room than that
+      std::vector<void*> d_rx_spill_bufs;
+      size_t d_rx_spill_samps, d_rx_spill_off, d_rx_spill_len;
+      std::vector<void*> d_out_bufs;  // Scratch list of output pointers for general_work
+
+      // Optional RX thread: drains the radio into d_rx_rings (one per channel, filled in lockstep), general_work
+      // copies out of them
+      bool d_use_rx_thread;
+      int d_rx_core;
+      std::vector<std::unique_ptr<spsc_ring<uint8_t>>> d_rx_rings;  // Byte rings, so they hold either sample type
+      size_t rx_rings_size() const;
+      std::thread d_rx_thread;
+      std::atomic<bool> d_rx_thread_stop, d_rx_thread_failed, d_rx_active;
+      std::mutex d_rx_mutex;
+      std::condition_variable d_rx_cond;  // Signalled when the RX thread adds samples to the ring
+      void rx_thread_loop();
+      void stop_rx_thread();
+
+      // Device-time schedule: round r covers [r, r+1) * d_round_seconds
+      float d_round_seconds;
+      int d_tx_packets_per_round = 5;
+      long long d_first_round, d_round;  // First round of this run, last round scheduled so far
+      std::atomic<int> d_rx_windows_pending;  // Timed RX windows issued and not yet finished (continuous streaming counts as one)
+      std::mutex d_rx_window_mutex;
+      std::deque<double> d_rx_window_starts;  // Device start times of the pending windows, oldest first
+      void rx_window_issued(double start);
+      void rx_window_done();
+      bool rx_window_overdue(double since);  // Whether the oldest pending window (plus guard) had started by `since`
+      float d_rx_burst_guard;  // Burst mode: margin around each expected packet (0 receives whole rounds)
+      void issue_rx_window(double from, double to);
+      void schedule_round(long long round);
+      void advance_schedule(double now);
+      double next_schedule_time() const;  // Device time at which the next round must be issued
+      void report_async(const uhd::async_metadata_t& md);
+      int receive(const std::vector<void*>& outs, int noutput_items, double timeout);
+
+      // Full duplex: continuous RX, rounds scheduled by a TX worker thread
+      bool d_full_duplex;
+      std::thread d_tx_thread;
+      std::atomic<bool> d_tx_thread_stop;
+      void tx_thread_loop();
+
+      // Hop plan: carriers visited for the given dwell times, restarting at every round (empty: one carrier per
+      // exchange). Hops within d_dsp_range of the LO only retune the DSP.
+      std::mutex d_plan_mutex;
+      std::vector<double> d_hop_freqs, d_hop_dwells;
+      double d_dsp_range;
+
+      // Startup: time reset at the next PPS (skipped when the device time already runs on the PPS) and LO lock
+      void reset_device_time();
+      void wait_lo_locked();
+
+      // Mapping from device time to output items, and tags still to be placed. Every stretch received without a gap
+      // keeps its own (device time, item) reference until it has been produced, since the RX thread can be a whole
+      // ring ahead of general_work.
+      std::mutex d_tag_mutex;
+      std::deque<std::pair<double, uint64_t>> d_rx_time_refs;
+      std::deque<std::tuple<double, pmt::pmt_t, pmt::pmt_t>> d_pending_tags;  // (device time, key, value)
+      void queue_tag(double at, const pmt::pmt_t& key, const pmt::pmt_t& value);
+      void add_pending_tags(int n_written);
+
+      // Telemetry, published on the "stats" port at most once per STATS_PERIOD
+      std::atomic<uint64_t> d_overflows, d_underflows, d_late_commands, d_late_bursts, d_timeouts;
+      std::atomic<uint64_t> d_samples, d_tx_packets, d_rx_dropped;
+      struct rx_stamp {
+        uint64_t item_end;  // Output item just past the received packet
+        std::chrono::steady_clock::time_point time;  // When recv returned it
+      };
+      std::unique_ptr<spsc_ring<rx_stamp>> d_rx_stamps;  // Written by whichever thread receives, read by general_work
+      bool d_has_stamp;
+      rx_stamp d_stamp;  // Oldest stamp taken out of d_rx_stamps but not yet produced
+      std::vector<uint64_t> d_latency_hist;  // recv-to-produce latency, bin k: [2^k, 2^(k+1)) us
+      std::chrono::steady_clock::time_point d_last_report;
+      void stamp_rx(uint64_t item_end);
+      void record_latency(uint64_t produced_end);
+      void report_stats();
 
      public:
-      usrp_tx_rx_impl(int channel, float carrier_freq, float sampling_rate, int samps_per_sym, float gain, int packet_len, bool start_tx, const std::vector<gr_complex>& ts_buf);
+      usrp_tx_rx_impl(int channel, float carrier_freq, float sampling_rate, int samps_per_sym, float gain, int packet_len, bool start_tx, const std::vector<gr_complex>& ts_buf, const std::string& args, bool rx_thread, int rx_core, float round_seconds, bool full_duplex, const std::vector<int>& rx_channels, bool sc16_output, float rx_burst_guard, float excess_bw);
       ~usrp_tx_rx_impl();
 
       bool start();
+      bool stop();
+
+      long overflows() const override { return d_overflows; }
+      long underflows() const override { return d_underflows; }
+      long late_commands() const override { return d_late_commands; }
+      long late_bursts() const override { return d_late_bursts; }
+      long timeouts() const override { return d_timeouts; }
+      long samples_delivered() const override { return d_samples; }
+      long tx_packets() const override { return d_tx_packets; }
+      long rx_dropped() const override { return d_rx_dropped; }
+      void setup_rpc() override;
 
-      // Sends packet_len number of samples stored in `in`
-      void usrp_tx_rx_impl::send_ranging_packet(const std::vector<gr_complex>& buf, int count_till_switch, gr_complex prev_chan_est, int repetition);
+      // Queues the training sequence followed by count_till_switch for transmission at device time `at`
+      void send_ranging_packet(int count_till_switch, gr_complex prev_chan_est, int repetition, double at);
 
-      void usrp_tx_rx_impl::hop_frequency(float new_frequency);
+      // Retunes TX and RX at device time `at`, returns how long the front end needs to settle
+      double hop_frequency(double new_frequency, double at, double dsp_range);
 
-      // Wait for a packet until one comes
-      size_t usrp_tx_rx_impl::recv_into_buf(std::vector<gr_complex> &buf, const size_t n);
+      void set_hop_plan(const std::vector<double>& freqs, const std::vector<double>& dwell_seconds, double dsp_range);
 
-      void usrp_tx_rx_impl::start_continuous_streaming();
+      // Wait for a packet until one comes (or the timeout passes), bufs holds one buffer per RX channel
+      // `item` is the output item index bufs[i][0] will have (used to map device time to output items)
+      size_t recv_into_buf(const std::vector<void*>& bufs, const size_t n, double timeout, uint64_t item);
 
-      void usrp_tx_rx_impl::stop_continuous_streaming();
+      void stop_continuous_streaming();
 
       // Where all the action really happens
       void forecast(int noutput_items, gr_vector_int &ninput_items_required);
@@ -19,3 +19,12 @@ static const char* __doc_gr_radar_dsp_pulse_align = R"doc()doc";
 
 
 static const char* __doc_gr_radar_dsp_pulse_align_make = R"doc()doc";
+
+
+static const char* __doc_gr_radar_dsp_pulse_align_calls = R"doc()doc";
+
+
+static const char* __doc_gr_radar_dsp_pulse_align_vectors_processed = R"doc()doc";
+
+
+static const char* __doc_gr_radar_dsp_pulse_align_energy_margin = R"doc()doc";
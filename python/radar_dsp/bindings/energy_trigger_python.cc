@@ -14,7 +14,7 @@
 /* BINDTOOL_GEN_AUTOMATIC(0)                                                       */
 /* BINDTOOL_USE_PYGCCXML(0)                                                        */
 /* BINDTOOL_HEADER_FILE(energy_trigger.h)                                        */
-/* BINDTOOL_HEADER_FILE_HASH(208d55c9ec3b781fb6ed7a7402160650)                     */
+/* BINDTOOL_HEADER_FILE_HASH(75c747bc97abd062bfc071186de938cd)                     */
 /***********************************************************************************/
 
 #include <pybind11/complex.h>
@@ -37,6 +37,10 @@ void bind_energy_trigger(py::module& m)
         std::shared_ptr<energy_trigger>>(m, "energy_trigger", D(energy_trigger))
 
         .def(py::init(&energy_trigger::make),
+           py::arg("energy_threshold"),
+           py::arg("buf_len_before"),
+           py::arg("buf_len_at_after"),
+           py::arg("sc16_input") = false,
            D(energy_trigger,make)
         )
         
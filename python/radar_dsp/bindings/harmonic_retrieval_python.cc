@@ -14,7 +14,7 @@
 /* BINDTOOL_GEN_AUTOMATIC(0)                                                       */
 /* BINDTOOL_USE_PYGCCXML(0)                                                        */
 /* BINDTOOL_HEADER_FILE(harmonic_retrieval.h)                                        */
-/* BINDTOOL_HEADER_FILE_HASH(88de119bc8f43222118dcbad7167593a)                     */
+/* BINDTOOL_HEADER_FILE_HASH(e50c7dd68ae4f79057b97dd718a72d30)                     */
 /***********************************************************************************/
 
 #include <pybind11/complex.h>
@@ -34,11 +34,25 @@ void bind_harmonic_retrieval(py::module& m)
 
 
     py::class_<harmonic_retrieval, gr::block, gr::basic_block,
-        std::shared_ptr<harmonic_retrieval>>(m, "harmonic_retrieval", D(harmonic_retrieval))
+        std::shared_ptr<harmonic_retrieval>> harmonic_retrieval_class(m, "harmonic_retrieval", D(harmonic_retrieval));
 
+    py::enum_<harmonic_retrieval::estimator_t>(harmonic_retrieval_class, "estimator_t")
+        .value("INTERP_3BIN", harmonic_retrieval::INTERP_3BIN)
+        .value("CHIRP_Z", harmonic_retrieval::CHIRP_Z)
+        .value("ESPRIT", harmonic_retrieval::ESPRIT)
+        .export_values();
+
+    harmonic_retrieval_class
         .def(py::init(&harmonic_retrieval::make),
            py::arg("samp_rate"),
            py::arg("fft_size"),
+           py::arg("time_domain") = false,
+           py::arg("window") = std::vector<float>(),
+           py::arg("estimator") = harmonic_retrieval::INTERP_3BIN,
+           py::arg("zoom_points") = 64,
+           py::arg("n_harmonics") = 1,
+           py::arg("subspace_len") = 16,
+           py::arg("forgetting") = 0.9,
            D(harmonic_retrieval,make)
         )
         
@@ -0,0 +1,47 @@
+/*
+ * Copyright 2023 Free Software Foundation, Inc.
+ *
+ * This file is part of GNU Radio
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ */
+
+/***********************************************************************************/
+/* This file is automatically generated using bindtool and can be manually edited  */
+/* The following lines can be configured to regenerate this file during cmake      */
+/* If manual edits are made, the following tags should be modified accordingly.    */
+/* BINDTOOL_GEN_AUTOMATIC(0)                                                       */
+/* BINDTOOL_USE_PYGCCXML(0)                                                        */
+/* BINDTOOL_HEADER_FILE(header_decoder.h)                                     */
+/* BINDTOOL_HEADER_FILE_HASH(13e64156e06dc4aca7110fbe5f0865a7)                     */
+/***********************************************************************************/
+
+#include <pybind11/complex.h>
+#include <pybind11/pybind11.h>
+#include <pybind11/stl.h>
+
+namespace py = pybind11;
+
+#include <gnuradio/radar_dsp/header_decoder.h>
+// pydoc.h is automatically generated in the build directory
+#include <header_decoder_pydoc.h>
+
+void bind_header_decoder(py::module& m)
+{
+
+    using header_decoder = gr::radar_dsp::header_decoder;
+
+
+    py::class_<header_decoder, gr::sync_block, gr::block, gr::basic_block,
+        std::shared_ptr<header_decoder>>(m, "header_decoder", D(header_decoder))
+
+        .def(py::init(&header_decoder::make),
+             py::arg("training_seq_len"),
+             py::arg("packet_len"),
+             py::arg("samp_rate"),
+             D(header_decoder, make))
+
+
+        ;
+}
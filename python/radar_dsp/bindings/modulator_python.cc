@@ -0,0 +1,47 @@
+/*
+ * Copyright 2023 Free Software Foundation, Inc.
+ *
+ * This file is part of GNU Radio
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ */
+
+/***********************************************************************************/
+/* This file is automatically generated using bindtool and can be manually edited  */
+/* The following lines can be configured to regenerate this file during cmake      */
+/* If manual edits are made, the following tags should be modified accordingly.    */
+/* BINDTOOL_GEN_AUTOMATIC(0)                                                       */
+/* BINDTOOL_USE_PYGCCXML(0)                                                        */
+/* BINDTOOL_HEADER_FILE(modulator.h)                                          */
+/* BINDTOOL_HEADER_FILE_HASH(178108ee01ee7ef8bda02c812459217c)                     */
+/***********************************************************************************/
+
+#include <pybind11/complex.h>
+#include <pybind11/pybind11.h>
+#include <pybind11/stl.h>
+
+namespace py = pybind11;
+
+#include <gnuradio/radar_dsp/modulator.h>
+// pydoc.h is automatically generated in the build directory
+#include <modulator_pydoc.h>
+
+void bind_modulator(py::module& m)
+{
+
+    using modulator = gr::radar_dsp::modulator;
+
+
+    py::class_<modulator, gr::sync_interpolator, gr::sync_block, gr::block, gr::basic_block,
+        std::shared_ptr<modulator>>(m, "modulator", D(modulator))
+
+        .def(py::init(&modulator::make),
+             py::arg("bits_per_symbol"),
+             py::arg("samps_per_sym"),
+             py::arg("excess_bw") = 0.35,
+             D(modulator, make))
+
+
+        ;
+}
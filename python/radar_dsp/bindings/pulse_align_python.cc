@@ -14,7 +14,7 @@
 /* BINDTOOL_GEN_AUTOMATIC(0)                                                       */
 /* BINDTOOL_USE_PYGCCXML(0)                                                        */
 /* BINDTOOL_HEADER_FILE(pulse_align.h)                                        */
-/* BINDTOOL_HEADER_FILE_HASH(be6e8cb055d8371a486d8a2eda281e4e)                     */
+/* BINDTOOL_HEADER_FILE_HASH(05610e127ff96b1403de366638366638)                     */
 /***********************************************************************************/
 
 #include <pybind11/complex.h>
@@ -33,15 +33,32 @@ void bind_pulse_align(py::module& m)
     using pulse_align = gr::radar_dsp::pulse_align;
 
 
-    py::class_<pulse_align, gr::block, gr::basic_block, std::shared_ptr<pulse_align>>(
-        m, "pulse_align", D(pulse_align))
+    py::class_<pulse_align, gr::block, gr::basic_block, std::shared_ptr<pulse_align>>
+        pulse_align_class(m, "pulse_align", D(pulse_align));
 
+    py::enum_<pulse_align::timing_t>(pulse_align_class, "timing_t")
+        .value("ENERGY_SEARCH", pulse_align::ENERGY_SEARCH)
+        .value("GARDNER", pulse_align::GARDNER)
+        .value("MUELLER_MULLER", pulse_align::MUELLER_MULLER)
+        .export_values();
+
+    pulse_align_class
         .def(py::init(&pulse_align::make),
              py::arg("input_buffer_len"),
              py::arg("samp_rate"),
              py::arg("samps_per_sym"),
+             py::arg("streaming") = false,
+             py::arg("reeval_interval") = 16,
+             py::arg("timing") = pulse_align::ENERGY_SEARCH,
+             py::arg("loop_bw") = 0.01,
+             py::arg("verbose") = false,
+             py::arg("excess_bw") = 0.35,
              D(pulse_align, make))
 
+        .def("calls", &pulse_align::calls, D(pulse_align, calls))
+        .def("vectors_processed", &pulse_align::vectors_processed, D(pulse_align, vectors_processed))
+        .def("energy_margin", &pulse_align::energy_margin, D(pulse_align, energy_margin))
+
 
         ;
 }
@@ -31,6 +31,10 @@ namespace py = pybind11;
     void bind_channel_estimator(py::module& m);
     void bind_energy_trigger(py::module& m);
     void bind_pulse_align(py::module& m);
+    void bind_subband_ddc(py::module& m);
+    void bind_modulator(py::module& m);
+    void bind_header_decoder(py::module& m);
+    void bind_ranging_receiver(py::module& m);
 // ) END BINDING_FUNCTION_PROTOTYPES
 
 
@@ -69,5 +73,9 @@ PYBIND11_MODULE(radar_dsp_python, m)
     bind_channel_estimator(m);
     bind_energy_trigger(m);
     bind_pulse_align(m);
+    bind_subband_ddc(m);
+    bind_modulator(m);
+    bind_header_decoder(m);
+    bind_ranging_receiver(m);
     // ) END BINDING_FUNCTION_CALLS
 }
\ No newline at end of file
@@ -0,0 +1,50 @@
+/*
+ * Copyright 2023 Free Software Foundation, Inc.
+ *
+ * This file is part of GNU Radio
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ */
+
+/***********************************************************************************/
+/* This file is automatically generated using bindtool and can be manually edited  */
+/* The following lines can be configured to regenerate this file during cmake      */
+/* If manual edits are made, the following tags should be modified accordingly.    */
+/* BINDTOOL_GEN_AUTOMATIC(0)                                                       */
+/* BINDTOOL_USE_PYGCCXML(0)                                                        */
+/* BINDTOOL_HEADER_FILE(ranging_receiver.h)                                   */
+/* BINDTOOL_HEADER_FILE_HASH(1fb1c830da4341d856cf50830e450ef4)                     */
+/***********************************************************************************/
+
+#include <pybind11/complex.h>
+#include <pybind11/pybind11.h>
+#include <pybind11/stl.h>
+
+namespace py = pybind11;
+
+#include <gnuradio/radar_dsp/ranging_receiver.h>
+// pydoc.h is automatically generated in the build directory
+#include <ranging_receiver_pydoc.h>
+
+void bind_ranging_receiver(py::module& m)
+{
+
+    using ranging_receiver = gr::radar_dsp::ranging_receiver;
+
+
+    py::class_<ranging_receiver, gr::sync_block, gr::block, gr::basic_block,
+        std::shared_ptr<ranging_receiver>>(m, "ranging_receiver", D(ranging_receiver))
+
+        .def(py::init(&ranging_receiver::make),
+             py::arg("training_seq_len"),
+             py::arg("packet_len"),
+             py::arg("samp_rate"),
+             py::arg("ts_buf"),
+             py::arg("f_c"),
+             py::arg("tone_frequencies"),
+             D(ranging_receiver, make))
+
+
+        ;
+}
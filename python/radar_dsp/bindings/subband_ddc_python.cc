@@ -0,0 +1,48 @@
+/*
+ * Copyright 2023 Free Software Foundation, Inc.
+ *
+ * This file is part of GNU Radio
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ */
+
+/***********************************************************************************/
+/* This file is automatically generated using bindtool and can be manually edited  */
+/* The following lines can be configured to regenerate this file during cmake      */
+/* If manual edits are made, the following tags should be modified accordingly.    */
+/* BINDTOOL_GEN_AUTOMATIC(0)                                                       */
+/* BINDTOOL_USE_PYGCCXML(0)                                                        */
+/* BINDTOOL_HEADER_FILE(subband_ddc.h)                                        */
+/* BINDTOOL_HEADER_FILE_HASH(9c0d64202c0adcd11244c721ef0d1fb8)                     */
+/***********************************************************************************/
+
+#include <pybind11/complex.h>
+#include <pybind11/pybind11.h>
+#include <pybind11/stl.h>
+
+namespace py = pybind11;
+
+#include <gnuradio/radar_dsp/subband_ddc.h>
+// pydoc.h is automatically generated in the build directory
+#include <subband_ddc_pydoc.h>
+
+void bind_subband_ddc(py::module& m)
+{
+
+    using subband_ddc = gr::radar_dsp::subband_ddc;
+
+
+    py::class_<subband_ddc, gr::sync_decimator, gr::sync_block, gr::block, gr::basic_block,
+        std::shared_ptr<subband_ddc>>(m, "subband_ddc", D(subband_ddc))
+
+        .def(py::init(&subband_ddc::make),
+             py::arg("sampling_rate"),
+             py::arg("offsets"),
+             py::arg("decimation"),
+             py::arg("bandwidth"),
+             D(subband_ddc, make))
+
+
+        ;
+}
@@ -14,7 +14,7 @@
 /* BINDTOOL_GEN_AUTOMATIC(0)                                                       */
 /* BINDTOOL_USE_PYGCCXML(0)                                                        */
 /* BINDTOOL_HEADER_FILE(usrp_tx_rx.h)                                        */
-/* BINDTOOL_HEADER_FILE_HASH(7fd829905856bc9618239dd1978d9329)                     */
+/* BINDTOOL_HEADER_FILE_HASH(3bed5a4c9cb3c9dc9ad025998b6a2fc9)                     */
 /***********************************************************************************/
 
 #include <pybind11/complex.h>
@@ -45,8 +45,33 @@ void bind_usrp_tx_rx(py::module& m)
              py::arg("packet_len"),
              py::arg("start_tx"),
              py::arg("ts_buf"),
+             py::arg("args") = "",
+             py::arg("rx_thread") = false,
+             py::arg("rx_core") = -1,
+             py::arg("round_seconds") = 5.0,
+             py::arg("full_duplex") = false,
+             py::arg("rx_channels") = std::vector<int>(),
+             py::arg("sc16_output") = false,
+             py::arg("rx_burst_guard") = 0.0,
+             py::arg("excess_bw") = 0.35,
              D(usrp_tx_rx, make))
 
 
+        .def("set_hop_plan",
+             &usrp_tx_rx::set_hop_plan,
+             py::arg("freqs"),
+             py::arg("dwell_seconds"),
+             py::arg("dsp_range") = 0.0,
+             D(usrp_tx_rx, set_hop_plan))
+
+        .def("overflows", &usrp_tx_rx::overflows, D(usrp_tx_rx, overflows))
+        .def("underflows", &usrp_tx_rx::underflows, D(usrp_tx_rx, underflows))
+        .def("late_commands", &usrp_tx_rx::late_commands, D(usrp_tx_rx, late_commands))
+        .def("late_bursts", &usrp_tx_rx::late_bursts, D(usrp_tx_rx, late_bursts))
+        .def("timeouts", &usrp_tx_rx::timeouts, D(usrp_tx_rx, timeouts))
+        .def("samples_delivered", &usrp_tx_rx::samples_delivered, D(usrp_tx_rx, samples_delivered))
+        .def("tx_packets", &usrp_tx_rx::tx_packets, D(usrp_tx_rx, tx_packets))
+        .def("rx_dropped", &usrp_tx_rx::rx_dropped, D(usrp_tx_rx, rx_dropped))
+
         ;
 }